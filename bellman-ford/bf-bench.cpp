@@ -0,0 +1,96 @@
+/*
+ * This benchmarks the round-synchronous and the asynchronous engines of bf-solver.hpp
+ * Both engines answer the same queries; their results are checked against each other.
+ * Compile: g++ -std=c++17 -fopenmp -O2 -o bf-bench bf-bench.cpp
+ * Run: ./bf-bench <input file> <number of threads> [number of sources]
+ * */
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+#include "bf-solver.hpp"
+
+using std::string;
+using std::endl;
+
+namespace utils {
+    void abort_with_error_message(string msg) {
+        std::cerr << msg << endl;
+        abort();
+    }
+
+    double wall_time() {
+        timeval t;
+        gettimeofday(&t, nullptr);
+        return t.tv_sec + t.tv_usec / 1e6;
+    }
+}//namespace utils
+
+/**
+ * Time one engine over the given sources and keep its results.
+ * @return seconds spent in the queries
+ */
+template<typename Engine>
+double run(Engine &engine, const std::vector<int> &sources, std::vector<int> &results, int &negative_cycles) {
+    const int n = engine.graph().size();
+    results.resize(sources.size() * n);
+    negative_cycles = 0;
+    double busy = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        bool has_negative_cycle = false;
+        double t = utils::wall_time();
+        const int *dist = engine.query(sources[i], &has_negative_cycle);
+        busy += utils::wall_time() - t;
+        negative_cycles += has_negative_cycle;
+        std::copy(dist, dist + n, &results[i * n]);
+    }
+    return busy;
+}
+
+int main(int argc, char **argv) {
+    if (argc <= 1) {
+        utils::abort_with_error_message("INPUT FILE WAS NOT FOUND!");
+    }
+    if (argc <= 2) {
+        utils::abort_with_error_message("NUMBER OF THREADS WAS NOT FOUND!");
+    }
+    string filename = argv[1];
+    int p = atoi(argv[2]);
+    int k = argc > 3 ? atoi(argv[3]) : 16;
+
+    bf::Graph graph(filename);
+    const int n = graph.size();
+    std::vector<int> sources;
+    for (int i = 0; i < k && i < n; ++i)
+        sources.push_back((int) ((long long) i * n / k));
+
+    bf::Solver sync(graph, p);
+    bf::AsyncSolver async(graph, p);
+    std::vector<int> sync_results, async_results;
+    int sync_negative, async_negative;
+    // warm up the thread team once
+    bool has_negative_cycle;
+    sync.query(0, &has_negative_cycle);
+    double sync_time = run(sync, sources, sync_results, sync_negative);
+    double async_time = run(async, sources, async_results, async_negative);
+
+    int mismatches = 0;
+    if (sync_negative == 0 && async_negative == 0)
+        for (size_t i = 0; i < sync_results.size(); ++i)
+            mismatches += std::min(sync_results[i], INF) != std::min(async_results[i], INF);
+
+    std::cerr.setf(std::ios::fixed);
+    std::cerr << std::setprecision(6)
+              << "Vertices: " << n << "\tThreads: " << p << "\tSources: " << sources.size() << endl
+              << "sync  Time(s): " << sync_time << "\tper query: " << sync_time / sources.size()
+              << "\tnegative cycles: " << sync_negative << endl
+              << "async Time(s): " << async_time << "\tper query: " << async_time / sources.size()
+              << "\tnegative cycles: " << async_negative << endl
+              << std::setprecision(2) << "async speedup: " << sync_time / async_time << "x" << endl
+              << "Mismatched distances: " << mismatches << endl;
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * This is Johnson's all-pairs shortest paths on top of the openmp bellman_ford engine
+ * 1. The parallel Bellman-Ford of bf-solver.hpp runs once from a virtual source to get potentials h.
+ * 2. Every edge is reweighted to w(u, v) + h[u] - h[v] >= 0 and stored as a sparse (CSR) graph.
+ * 3. Dijkstra runs from every source, sources spread over the threads (and over the MPI ranks).
+ * Compile: g++ -std=c++17 -fopenmp -O2 -o bf-johnson bf-johnson.cpp
+ *      or: mpicxx -std=c++17 -fopenmp -O2 -DBF_MPI -o bf-johnson bf-johnson.cpp
+ * Run: ./bf-johnson <input file> <number of threads> [output file] [number of sources to benchmark]
+ *      (mpirun -n <number of processes> ./bf-johnson ... with BF_MPI)
+ *
+ * The output file (default 'apsp.bin') is a tiled binary matrix of int32, INF for no path:
+ *   header   int32 n, int32 T (tile size)
+ *   body     tile rows R = 0, 1, ... of T matrix rows each (fewer in the last one); within a tile
+ *            row, tiles C = 0, 1, ... of T columns each (fewer in the last one); each tile is
+ *            stored row by row. Tile row R therefore starts at 8 + 4 * R * T * n bytes.
+ * If the graph has a negative cycle, the output file holds 'FOUND NEGATIVE CYCLE!' instead.
+ *
+ * With a number of sources to benchmark, that many sources are also solved one by one with the
+ * single-source engine, checked against the APSP rows and timed; the time of n such runs is
+ * extrapolated from them. The benchmark reports its own time, which Time(s) leaves out.
+ * */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <string>
+#include <sys/time.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#ifdef BF_MPI
+#include "mpi.h"
+#endif
+
+#include "bf-solver.hpp"
+
+using std::string;
+using std::endl;
+using std::vector;
+
+const int TILE = 64;
+
+namespace utils {
+    void abort_with_error_message(string msg) {
+        std::cerr << msg << endl;
+        abort();
+    }
+
+    double wall_time() {
+        timeval t;
+        gettimeofday(&t, nullptr);
+        return t.tv_sec + t.tv_usec / 1e6;
+    }
+}//namespace utils
+
+/**
+ * The reweighted graph in compressed sparse row form: the out-edges of u are
+ * adj[offset[u]] .. adj[offset[u + 1] - 1].
+ */
+struct Reweighted {
+    int n;
+    vector<int> offset;
+    vector<std::pair<int, long long>> adj;      // (v, w(u, v) + h[u] - h[v])
+
+    Reweighted(const bf::Graph &g, const int *h) : n(g.size()), offset(g.size() + 1, 0) {
+        for (int u = 0; u < n; ++u) {
+            for (int v = 0; v < n; ++v) {
+                int w = g.weight(u, v);
+                if (u != v && w < INF)
+                    adj.emplace_back(v, (long long) w + h[u] - h[v]);
+            }
+            offset[u + 1] = (int) adj.size();
+        }
+    }
+};
+
+/**
+ * Dijkstra on the reweighted graph with its own heap and distance buffer, one per thread.
+ */
+class Dijkstra {
+public:
+    explicit Dijkstra(const Reweighted &g) : g(g), d(g.n) {}
+
+    //write the original-weight distances from source into row
+    void run(int source, const int *h, int *row) {
+        typedef std::pair<long long, int> Entry;
+        const long long unreached = std::numeric_limits<long long>::max();
+        std::fill(d.begin(), d.end(), unreached);
+        d[source] = 0;
+        heap.clear();
+        heap.emplace_back(0, source);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+            Entry top = heap.back();
+            heap.pop_back();
+            int u = top.second;
+            if (top.first > d[u])
+                continue;
+            for (int k = g.offset[u]; k < g.offset[u + 1]; ++k) {
+                int v = g.adj[k].first;
+                long long dv = d[u] + g.adj[k].second;
+                if (dv < d[v]) {
+                    d[v] = dv;
+                    heap.emplace_back(dv, v);
+                    std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+                }
+            }
+        }
+        for (int v = 0; v < g.n; ++v) {
+            long long dv = d[v] == unreached ? INF : d[v] - h[source] + h[v];
+            row[v] = dv > INF ? INF : (int) dv;
+        }
+    }
+
+private:
+    const Reweighted &g;
+    vector<long long> d;
+    vector<std::pair<long long, int>> heap;
+};
+
+/**
+ * Solve the tile rows R = first, first + stride, ... and write them into the output file.
+ * @return seconds spent
+ */
+double all_pairs(const Reweighted &g, const int *h, int p, int fd, int first, int stride) {
+    const int n = g.n;
+    const int tile_rows = (n + TILE - 1) / TILE;
+    vector<int> rows((size_t) TILE * n), tiled((size_t) TILE * n);
+    vector<Dijkstra *> engines(p);
+    for (int t = 0; t < p; ++t)
+        engines[t] = new Dijkstra(g);
+
+    double start = utils::wall_time();
+    for (int R = first; R < tile_rows; R += stride) {
+        const int r0 = R * TILE, height = std::min(TILE, n - r0);
+        #pragma omp parallel for num_threads(p) schedule(dynamic)
+        for (int i = 0; i < height; ++i)
+            engines[omp_get_thread_num()]->run(r0 + i, h, &rows[(size_t) i * n]);
+
+        // rearrange the tile row into tiles
+        size_t k = 0;
+        for (int c0 = 0; c0 < n; c0 += TILE) {
+            const int width = std::min(TILE, n - c0);
+            for (int i = 0; i < height; ++i) {
+                std::copy_n(&rows[(size_t) i * n + c0], width, &tiled[k]);
+                k += width;
+            }
+        }
+        off_t at = 2 * sizeof(int) + (off_t) R * TILE * n * sizeof(int);
+        if (pwrite(fd, tiled.data(), k * sizeof(int), at) != (ssize_t) (k * sizeof(int)))
+            utils::abort_with_error_message("ERROR OCCURRED WHILE WRITING OUTPUT FILE");
+    }
+    double elapsed = utils::wall_time() - start;
+
+    for (int t = 0; t < p; ++t)
+        delete engines[t];
+    return elapsed;
+}
+
+/**
+ * Solve some sources one by one with the single-source engine and check them against Dijkstra.
+ * @return seconds spent
+ */
+double benchmark(bf::Solver &solver, const Reweighted &g, const int *h, int sources, double apsp_time) {
+    double start = utils::wall_time();
+    const int n = g.n;
+    sources = std::min(sources, n);
+    vector<int> row(n);
+    Dijkstra dijkstra(g);
+    double busy = 0;
+    int mismatches = 0;
+    for (int i = 0; i < sources; ++i) {
+        int source = (int) ((long long) i * n / sources);
+        bool has_negative_cycle = false;
+        double t = utils::wall_time();
+        const int *dist = solver.query(source, &has_negative_cycle);
+        busy += utils::wall_time() - t;
+        dijkstra.run(source, h, row.data());
+        for (int v = 0; v < n; ++v)
+            if (std::min(dist[v], INF) != row[v])
+                ++mismatches;
+    }
+    std::cerr.setf(std::ios::fixed);
+    std::cerr << std::setprecision(6)
+              << "Single-source Bellman-Ford: " << sources << " sources in " << busy << " s, "
+              << "extrapolated to " << n << " sources: " << (busy / sources * n) << " s" << endl
+              << "Johnson APSP: " << apsp_time << " s, speedup "
+              << std::setprecision(2) << (busy / sources * n / apsp_time) << "x" << endl
+              << "Mismatched distances: " << mismatches << endl;
+    return utils::wall_time() - start;
+}
+
+int main(int argc, char **argv) {
+    int my_rank = 0, num_procs = 1;
+#ifdef BF_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_size(comm, &num_procs);
+    MPI_Comm_rank(comm, &my_rank);
+#endif
+    if (argc <= 1) {
+        utils::abort_with_error_message("INPUT FILE WAS NOT FOUND!");
+    }
+    if (argc <= 2) {
+        utils::abort_with_error_message("NUMBER OF THREADS WAS NOT FOUND!");
+    }
+    string filename = argv[1];
+    int p = atoi(argv[2]);
+    string output = argc > 3 ? argv[3] : "apsp.bin";
+    int sources = argc > 4 ? atoi(argv[4]) : 0;
+
+    double t1 = utils::wall_time();
+
+    // every rank needs the graph and the potentials; rank 0 does the I/O and the Bellman-Ford
+    int n = 0;
+    bf::Graph *graph = nullptr;
+    vector<int> mat;
+    if (my_rank == 0) {
+        graph = new bf::Graph(filename);
+        n = graph->size();
+    }
+#ifdef BF_MPI
+    MPI_Bcast(&n, 1, MPI_INT, 0, comm);
+    if (my_rank != 0) {
+        mat.resize((size_t) n * n);
+        graph = new bf::Graph(n, mat.data());
+    }
+    // in chunks of whole rows, as n * n overflows the int count of MPI_Bcast beyond n = 46340
+    const int chunk_rows = std::max(1, std::numeric_limits<int>::max() / std::max(n, 1));
+    for (int r = 0; r < n; r += chunk_rows) {
+        int *chunk = const_cast<int *>(graph->matrix()) + (size_t) r * n;
+        MPI_Bcast(chunk, std::min(chunk_rows, n - r) * n, MPI_INT, 0, comm);
+    }
+#endif
+
+    bf::Solver solver(*graph, p);
+    vector<int> h(n);
+    bool has_negative_cycle = false;
+    if (my_rank == 0) {
+        const int *potentials = solver.potentials(&has_negative_cycle);
+        std::copy(potentials, potentials + n, h.begin());
+    }
+#ifdef BF_MPI
+    MPI_Bcast(&has_negative_cycle, 1, MPI_C_BOOL, 0, comm);
+    MPI_Bcast(h.data(), n, MPI_INT, 0, comm);
+#endif
+    double t2 = utils::wall_time();
+    double benchmark_time = 0;
+
+    if (has_negative_cycle) {
+        if (my_rank == 0) {
+            FILE *f = fopen(output.c_str(), "w");
+            fprintf(f, "FOUND NEGATIVE CYCLE!\n");
+            fclose(f);
+        }
+    } else {
+        Reweighted reweighted(*graph, h.data());
+        int fd = open(output.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0)
+            utils::abort_with_error_message("ERROR OCCURRED WHILE OPENING OUTPUT FILE");
+        if (my_rank == 0) {
+            int header[2] = {n, TILE};
+            if (ftruncate(fd, 2 * sizeof(int) + (off_t) n * n * sizeof(int)) != 0
+                || pwrite(fd, header, sizeof(header), 0) != sizeof(header))
+                utils::abort_with_error_message("ERROR OCCURRED WHILE WRITING OUTPUT FILE");
+        }
+#ifdef BF_MPI
+        MPI_Barrier(comm);
+#endif
+        double apsp_time = all_pairs(reweighted, h.data(), p, fd, my_rank, num_procs);
+        close(fd);
+#ifdef BF_MPI
+        MPI_Allreduce(MPI_IN_PLACE, &apsp_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+#endif
+        if (my_rank == 0 && sources > 0)
+            benchmark_time = benchmark(solver, reweighted, h.data(), sources, apsp_time);
+    }
+    double t3 = utils::wall_time();
+
+    if (my_rank == 0) {
+        std::cerr.setf(std::ios::fixed);
+        std::cerr << std::setprecision(6) << "Potentials time(s): " << (t2 - t1) << endl;
+        std::cerr << std::setprecision(6) << "Time(s): " << (t3 - t1 - benchmark_time) << endl;
+        if (sources > 0 && !has_negative_cycle)
+            std::cerr << std::setprecision(6) << "Benchmark time(s): " << benchmark_time << endl;
+    }
+    delete graph;
+#ifdef BF_MPI
+    MPI_Finalize();
+#endif
+    return 0;
+}
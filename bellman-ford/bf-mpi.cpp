@@ -2,6 +2,9 @@
 
 // MPI Bellman-Ford
 
+// Compile: mpicxx -std=c++17 -o bf-mpi bf-mpi.cpp
+// Run: mpirun -n <number of processes> ./bf-mpi <input file> [output file, default 'output.txt']
+
 #include <algorithm>
 #include <cassert>
 #include <cstring>
@@ -12,6 +15,8 @@
 
 #include "mpi.h"
 
+#include "bf-output.hpp"
+
 using std::cout;
 using std::endl;
 using std::string;
@@ -52,20 +57,8 @@ namespace utils {
         return 0;
     }
 
-    int print_result(bool has_negative_cycle, int *dist) {
-        std::ofstream outputf("output.txt", std::ofstream::out);
-        if (!has_negative_cycle) {
-            for (int i = 0; i < N; i++) {
-                if (dist[i] > INF)
-                    dist[i] = INF;
-                outputf << dist[i] << '\n';
-            }
-            outputf.flush();
-        } else {
-            outputf << "FOUND NEGATIVE CYCLE!" << endl;
-        }
-        outputf.close();
-        return 0;
+    int print_result(bool has_negative_cycle, const int *dist, const string &filename = "output.txt") {
+        return bf::write_result(filename, has_negative_cycle, dist, N);
     }
 }
 
@@ -159,6 +152,7 @@ int main(int argc, char **argv) {
         utils::abort_with_error_message("INPUT FILE WAS NOT FOUND!");
     }
     string filename = argv[1];
+    string output = argc > 2 ? argv[2] : "output.txt";
 
     int *dist;
     bool has_negative_cycle = false;
@@ -194,7 +188,8 @@ int main(int argc, char **argv) {
     if (my_rank == 0) {
         std::cerr.setf(std::ios::fixed);
         std::cerr << std::setprecision(6) << "Time(s): " << (t2 - t1) << endl;
-        utils::print_result(has_negative_cycle, dist);
+        if (utils::print_result(has_negative_cycle, dist, output) != 0)
+            utils::abort_with_error_message("ERROR OCCURRED WHILE WRITING OUTPUT FILE");
         free(dist);
         free(utils::mat);
     }
@@ -0,0 +1,130 @@
+/*
+ * This writes a distance array as the result file of the bellman_ford programs
+ * The text format is the one utils::print_result always wrote: one distance per line, distances
+ * above INF written as INF, or the single line 'FOUND NEGATIVE CYCLE!'. The numbers are formatted
+ * in parallel with std::to_chars into one buffer per thread and written with a single writev.
+ * The binary format is the n distances as raw int32 (clamped the same way), written through mmap;
+ * a negative cycle is still reported with the text line.
+ * Use: #include "bf-output.hpp" and compile with -std=c++17 (-fopenmp to format in parallel)
+ * */
+
+#ifndef BF_OUTPUT_HPP
+#define BF_OUTPUT_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include "omp.h"
+#endif
+
+#ifndef INF
+#define INF 1000000
+#endif
+
+namespace bf {
+
+    enum class Format { TEXT, BINARY };
+
+    namespace detail {
+        //write all of iov, resuming after partial writes
+        inline bool write_all(int fd, struct iovec *iov, int count) {
+            while (count > 0) {
+                ssize_t written = writev(fd, iov, std::min(count, IOV_MAX));
+                if (written < 0)
+                    return false;
+                while (count > 0 && (size_t) written >= iov->iov_len) {
+                    written -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+                if (count > 0) {
+                    iov->iov_base = (char *) iov->iov_base + written;
+                    iov->iov_len -= written;
+                }
+            }
+            return true;
+        }
+
+        inline bool write_text(int fd, const int *dist, int n) {
+            int p = 1;
+#ifdef _OPENMP
+            p = std::max(1, std::min(omp_get_max_threads(), n / 65536 + 1));
+#endif
+            // "-2147483648\n" is the longest line
+            const size_t line = 12;
+            std::vector<std::vector<char>> buffers(p);
+            std::vector<struct iovec> iov(p);
+#ifdef _OPENMP
+            #pragma omp parallel for num_threads(p) schedule(static, 1)
+#endif
+            for (int t = 0; t < p; ++t) {
+                int first = (int) ((long long) n * t / p), last = (int) ((long long) n * (t + 1) / p);
+                std::vector<char> &buffer = buffers[t];
+                buffer.resize((size_t) (last - first) * line);
+                char *at = buffer.data(), *end = buffer.data() + buffer.size();
+                for (int i = first; i < last; ++i) {
+                    at = std::to_chars(at, end, dist[i] > INF ? INF : dist[i]).ptr;
+                    *at++ = '\n';
+                }
+                iov[t].iov_base = buffer.data();
+                iov[t].iov_len = at - buffer.data();
+            }
+            return write_all(fd, iov.data(), p);
+        }
+
+        inline bool write_binary(int fd, const int *dist, int n) {
+            size_t size = (size_t) n * sizeof(int);
+            if (ftruncate(fd, size) != 0)
+                return false;
+            if (size == 0)
+                return true;
+            void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED)
+                return false;
+            int *out = (int *) map;
+#ifdef _OPENMP
+            #pragma omp parallel for schedule(static)
+#endif
+            for (int i = 0; i < n; ++i)
+                out[i] = dist[i] > INF ? INF : dist[i];
+            return munmap(map, size) == 0;
+        }
+    }//namespace detail
+
+    /**
+     * Write a result file. dist is not modified.
+     * @param path output file path
+     * @param has_negative_cycle whether a negative cycle was found
+     * @param *dist distance array of size n
+     * @param format text (one distance per line) or raw int32
+     * @return 0 on success, -1 on an I/O error
+     */
+    inline int write_result(const std::string &path, bool has_negative_cycle, const int *dist, int n,
+                            Format format = Format::TEXT) {
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return -1;
+        bool ok;
+        if (has_negative_cycle) {
+            const char message[] = "FOUND NEGATIVE CYCLE!\n";
+            ok = write(fd, message, strlen(message)) == (ssize_t) strlen(message);
+        } else if (format == Format::BINARY) {
+            ok = detail::write_binary(fd, dist, n);
+        } else {
+            ok = detail::write_text(fd, dist, n);
+        }
+        return close(fd) == 0 && ok ? 0 : -1;
+    }
+
+}//namespace bf
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * This is a local query driver on top of bf-solver.hpp
+ * The graph is loaded once and one Solver answers all queries, so only the first query pays for
+ * the file and the buffers.
+ * Compile: g++ -std=c++17 -fopenmp -o bf-serve bf-serve.cpp
+ * Run: ./bf-serve <input file> <number of threads> [unix socket path]
+ *
+ * A query is one line: <source> [<target> ...] [@<bound>]
+ * The reply is one line with the distances to the targets, or to all vertices if no target is given.
+ * With a bound, vertices farther than the bound are reported as INF. Targets and bound let the
+ * solver stop early on graphs without negative edges, see bf::Query.
+ * Without a socket path queries are read from stdin and replies written to stdout.
+ * With a socket path the driver serves one connection after another until a client sends "quit".
+ * Queries/sec is reported to stderr at the end of stdin or of each connection.
+ * */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bf-solver.hpp"
+
+using std::string;
+using std::endl;
+
+namespace utils {
+    void abort_with_error_message(string msg) {
+        std::cerr << msg << endl;
+        abort();
+    }
+
+    double wall_time() {
+        timeval t;
+        gettimeofday(&t, nullptr);
+        return t.tv_sec + t.tv_usec / 1e6;
+    }
+}//namespace utils
+
+/**
+ * Session answers queries read from in and writes replies to out.
+ * Query and reply buffers are reused from one line to the next.
+ */
+class Session {
+public:
+    explicit Session(bf::Solver &solver) : solver(solver) {}
+
+    //serve until end of input; return false if the client asked to quit
+    //a remote client waits for each reply, so flush every reply in that case
+    bool serve(FILE *in, FILE *out, bool flush_each = false) {
+        long long queries = 0, explored = 0;
+        double busy = 0;
+        double start = utils::wall_time();
+        bool quit = false;
+        char *line = nullptr;
+        size_t cap = 0;
+        while (getline(&line, &cap, in) != -1) {
+            if (strncmp(line, "quit", 4) == 0) {
+                quit = true;
+                break;
+            }
+            if (!parse(line))
+                continue;
+            if (!valid()) {
+                fprintf(out, "BAD QUERY\n");
+                if (flush_each)
+                    fflush(out);
+                continue;
+            }
+            bool has_negative_cycle = false;
+            double t = utils::wall_time();
+            const int *dist = solver.query(query, &has_negative_cycle);
+            busy += utils::wall_time() - t;
+            ++queries;
+            explored += solver.explored();
+            reply(out, dist, has_negative_cycle);
+            if (flush_each)
+                fflush(out);
+        }
+        free(line);
+        fflush(out);
+        double total = utils::wall_time() - start;
+
+        std::cerr.setf(std::ios::fixed);
+        std::cerr << std::setprecision(6) << "Queries: " << queries
+                  << "\tSolve time(s): " << busy
+                  << "\tQueries/s: " << (busy > 0 ? queries / busy : 0)
+                  << "\tExplored/query: " << (queries > 0 ? explored / queries : 0)
+                  << "\tWall time(s): " << total << endl;
+        return !quit;
+    }
+
+private:
+    bf::Solver &solver;
+    bf::Query query;
+    std::vector<int> targets;
+    string buffer;
+
+    bool parse(const char *line) {
+        targets.clear();
+        query = bf::Query();
+        char *end;
+        long v = strtol(line, &end, 10);
+        if (end == line)
+            return false;
+        query.source = (int) v;
+        for (line = end; ; line = end) {
+            v = strtol(line, &end, 10);
+            if (end == line)
+                break;
+            targets.push_back((int) v);
+        }
+        line += strspn(line, " \t");
+        if (*line == '@')
+            query.bound = (int) strtol(line + 1, nullptr, 10);
+        query.targets = targets.data();
+        query.num_targets = (int) targets.size();
+        return true;
+    }
+
+    bool valid() const {
+        const int n = solver.graph().size();
+        if (query.source < 0 || query.source >= n)
+            return false;
+        for (int v : targets)
+            if (v < 0 || v >= n)
+                return false;
+        return true;
+    }
+
+    void reply(FILE *out, const int *dist, bool has_negative_cycle) {
+        if (has_negative_cycle) {
+            fprintf(out, "FOUND NEGATIVE CYCLE!\n");
+            return;
+        }
+        const int n = solver.graph().size();
+        buffer.clear();
+        auto append = [&](int d) {
+            char s[16];
+            int len = snprintf(s, sizeof(s), "%d ", d > INF || d > query.bound ? INF : d);
+            buffer.append(s, len);
+        };
+        if (targets.empty())
+            for (int v = 0; v < n; ++v)
+                append(dist[v]);
+        else
+            for (int v : targets)
+                append(dist[v]);
+        if (!buffer.empty())
+            buffer.back() = '\n';
+        fwrite(buffer.data(), 1, buffer.size(), out);
+    }
+};
+
+void serve_socket(Session &session, const string &path) {
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        utils::abort_with_error_message("CANNOT CREATE SOCKET!");
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    if (bind(listener, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(listener, 1) < 0)
+        utils::abort_with_error_message("CANNOT LISTEN ON " + path);
+    std::cerr << "Listening on " << path << endl;
+
+    for (bool more = true; more; ) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        FILE *in = fdopen(fd, "r");
+        FILE *out = fdopen(dup(fd), "w");
+        more = session.serve(in, out, true);
+        fclose(out);
+        fclose(in);
+    }
+    close(listener);
+    unlink(path.c_str());
+}
+
+int main(int argc, char **argv) {
+    if (argc <= 1) {
+        utils::abort_with_error_message("INPUT FILE WAS NOT FOUND!");
+    }
+    if (argc <= 2) {
+        utils::abort_with_error_message("NUMBER OF THREADS WAS NOT FOUND!");
+    }
+    string filename = argv[1];
+    int p = atoi(argv[2]);
+
+    double t = utils::wall_time();
+    bf::Graph graph(filename);
+    bf::Solver solver(graph, p);
+    std::cerr.setf(std::ios::fixed);
+    std::cerr << std::setprecision(6) << "Load time(s): " << (utils::wall_time() - t) << endl;
+
+    Session session(solver);
+    if (argc > 3)
+        serve_socket(session, argv[3]);
+    else
+        session.serve(stdin, stdout);
+    return 0;
+}
@@ -0,0 +1,563 @@
+/*
+ * This is the openmp bellman_ford engine of bf-omp.cpp packaged as a library
+ * A Graph is loaded once, a Solver is built once on top of it, and then query() may be called
+ * any number of times. All scratch buffers are allocated by the Solver's constructor, so a query
+ * does not allocate.
+ * Solver relaxes in synchronized rounds; AsyncSolver relaxes without rounds or barriers.
+ * Use: #include "bf-solver.hpp" and compile with -std=c++17 -fopenmp
+ * */
+
+#ifndef BF_SOLVER_HPP
+#define BF_SOLVER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "omp.h"
+
+#ifndef INF
+#define INF 1000000
+#endif
+
+namespace bf {
+
+    /**
+     * Graph is an adjacency matrix of n * n weights, INF for no edge.
+     * It either owns the matrix (loaded from a file) or refers to one owned by the caller.
+     */
+    class Graph {
+    public:
+        //load the matrix from a file in the format written by genmat
+        explicit Graph(const std::string &filename) {
+            std::ifstream inputf(filename, std::ifstream::in);
+            if (!inputf.good()) {
+                std::cerr << "ERROR OCCURRED WHILE READING INPUT FILE" << std::endl;
+                abort();
+            }
+            inputf >> n;
+            //input matrix should be smaller than 20MB * 20MB (400MB, we don't have too much memory for multi-threads)
+            assert(n < (1024 * 1024 * 20));
+            storage.resize((size_t) n * n);
+            for (size_t i = 0; i < storage.size(); i++)
+                inputf >> storage[i];
+            mat = storage.data();
+            scan();
+        }
+
+        //refer to a matrix owned by the caller, which must outlive the graph
+        Graph(int n, const int *mat) : n(n), mat(mat) { scan(); }
+
+        Graph(const Graph &) = delete;
+        Graph &operator=(const Graph &) = delete;
+
+        int size() const { return n; }
+        const int *matrix() const { return mat; }
+        int weight(int u, int v) const { return mat[(size_t) u * n + v]; }
+        bool has_negative_edge() const { return negative_edge; }
+
+    private:
+        int n = 0;
+        const int *mat = nullptr;
+        std::vector<int> storage;
+        bool negative_edge = false;
+
+        void scan() {
+            const size_t size = (size_t) n * n;
+            for (size_t i = 0; i < size && !negative_edge; i++)
+                negative_edge = mat[i] < 0;
+        }
+    };
+
+    /**
+     * Query describes one search.
+     * With targets, the search may stop as soon as the distances to the targets are final; the
+     * distances to the other vertices are then only upper bounds.
+     * With a bound, vertices farther than bound from the source are left at INF.
+     * Both cut the search short only when the graph has no negative edge; otherwise the whole graph
+     * is solved and the result is filtered by the bound.
+     */
+    struct Query {
+        int source = 0;
+        const int *targets = nullptr;   // not owned, may be nullptr
+        int num_targets = 0;
+        int bound = INF;
+
+        Query() = default;
+        explicit Query(int source) : source(source) {}
+    };
+
+    /**
+     * Solver runs the round-synchronous parallel Bellman-Ford on a fixed graph with p threads.
+     * The vertices are partitioned among the threads once; thread t relaxes the edges into its own
+     * vertices [begin[t], begin[t] + load[t]). The OpenMP runtime keeps its team of p threads alive
+     * between parallel regions, so consecutive queries reuse the same threads.
+     *
+     * Each round relaxes only the frontier, the vertices improved in the last round, and only the
+     * vertices a query touched are reset before the next one, so a query costs time in proportion
+     * to the region it explores rather than to the whole graph.
+     */
+    class Solver {
+    public:
+        Solver(const Graph &graph, int p)
+                : g(graph), p(p), load(p), begin(p + 1),
+                  dist(graph.size(), INF), relaxed_rounds(graph.size(), 0), in_next(graph.size(), false),
+                  frontier(graph.size()), next(graph.size()), touched(graph.size()),
+                  next_count(p), touched_count(p, 0) {
+            assert(p > 0);
+            // task allocation
+            int n = g.size();
+            int q = n / p, r = n % p;
+            load[0] = q;
+            for (int i = 1; i < p; ++i)
+                load[i] = q + ((i <= r) ? 1 : 0);
+            begin[0] = 0;
+            for (int i = 1; i <= p; ++i)
+                begin[i] = begin[i - 1] + load[i - 1];
+            // keep the team size fixed so that the runtime can reuse its threads
+            omp_set_dynamic(0);
+        }
+
+        Solver(const Solver &) = delete;
+        Solver &operator=(const Solver &) = delete;
+
+        int num_threads() const { return p; }
+        const Graph &graph() const { return g; }
+
+        /**
+         * Find the shortest path from vertex source to all other vertices.
+         * @param source the source vertex
+         * @param *has_negative_cycle a bool variable to record if there are negative cycles
+         * @return the distance array of size n, valid until the next query
+         */
+        const int *query(int source, bool *has_negative_cycle) {
+            return query(Query(source), has_negative_cycle);
+        }
+
+        /**
+         * Run a query with optional targets and distance bound, see Query.
+         * @return the distance array of size n, valid until the next query
+         */
+        const int *query(const Query &q, bool *has_negative_cycle);
+
+        /**
+         * Distances from a virtual source with a 0-weight edge into every vertex, which are the
+         * vertex potentials of Johnson's algorithm: w(u, v) + h[u] - h[v] >= 0 for every edge.
+         * @param *has_negative_cycle a bool variable to record if there are negative cycles
+         * @return the potential array of size n, valid until the next query
+         */
+        const int *potentials(bool *has_negative_cycle);
+
+        //number of vertices whose distance the last query set
+        int explored() const {
+            int sum = 0;
+            for (int t = 0; t < p; ++t)
+                sum += touched_count[t];
+            return sum;
+        }
+
+    private:
+        const Graph &g;
+        int p;
+        std::vector<int> load, begin;
+        std::vector<int> dist;
+        std::vector<int> relaxed_rounds;    // rounds in which a vertex improved
+        std::vector<char> in_next;
+        // frontier of the current round; next and touched are split into per-thread segments
+        // [begin[t], begin[t + 1]) since a thread only ever adds its own vertices to them
+        std::vector<int> frontier, next, touched;
+        std::vector<int> next_count, touched_count;
+
+        void reset();
+        void relax(const Query &q, int frontier_size, bool *has_negative_cycle);
+
+        int owner(int v) const {
+            return (int) (std::upper_bound(begin.begin(), begin.end(), v) - begin.begin()) - 1;
+        }
+
+        //the distance no relaxation may reach, or INT_MAX if nothing is pruned
+        int cutoff(const Query &q) const {
+            if (g.has_negative_edge())
+                return std::numeric_limits<int>::max();
+            int c = q.bound < INF ? q.bound + 1 : std::numeric_limits<int>::max();
+            if (q.num_targets > 0) {
+                int farthest = 0;
+                for (int i = 0; i < q.num_targets; ++i)
+                    farthest = std::max(farthest, dist[q.targets[i]]);
+                // a path through a vertex at least this far cannot improve any target
+                c = std::min(c, farthest);
+            }
+            return c;
+        }
+    };
+
+    inline const int *Solver::query(const Query &q, bool *has_negative_cycle) {
+        const int n = g.size();
+        const int source = q.source;
+        assert(0 <= source && source < n);
+        for (int i = 0; i < q.num_targets; ++i)
+            assert(0 <= q.targets[i] && q.targets[i] < n);
+
+        // initialization
+        reset();
+        dist[source] = 0;
+        touched[begin[owner(source)] + touched_count[owner(source)]++] = source;
+        frontier[0] = source;
+        relax(q, 1, has_negative_cycle);
+
+        // without pruning the bound is applied to the result
+        if (q.bound < INF && g.has_negative_edge())
+            for (int t = 0; t < p; ++t)
+                for (int k = 0; k < touched_count[t]; ++k) {
+                    int v = touched[begin[t] + k];
+                    if (dist[v] > q.bound)
+                        dist[v] = INF;
+                }
+
+        return dist.data();
+    }
+
+    inline const int *Solver::potentials(bool *has_negative_cycle) {
+        const int n = g.size();
+
+        // the virtual source has already relaxed its 0-weight edge into every vertex
+        reset();
+        std::fill_n(dist.data(), n, 0);
+        for (int t = 0; t < p; ++t) {
+            touched_count[t] = begin[t + 1] - begin[t];
+            for (int v = begin[t]; v < begin[t + 1]; ++v)
+                touched[v] = v;
+        }
+        for (int v = 0; v < n; ++v)
+            frontier[v] = v;
+        Query q;
+        q.source = -1;
+        relax(q, n, has_negative_cycle);
+        return dist.data();
+    }
+
+    inline void Solver::reset() {
+        for (int t = 0; t < p; ++t) {
+            for (int k = 0; k < touched_count[t]; ++k) {
+                int v = touched[begin[t] + k];
+                dist[v] = INF;
+                relaxed_rounds[v] = 0;
+            }
+            touched_count[t] = 0;
+        }
+    }
+
+    inline void Solver::relax(const Query &q, int frontier_size, bool *has_negative_cycle) {
+        const int n = g.size();
+        const int *mat = g.matrix();
+        const int source = q.source;
+        int *dist = this->dist.data();
+        int limit = cutoff(q);
+        *has_negative_cycle = false;
+
+        #pragma omp parallel num_threads(p)
+        {
+            int my_rank = omp_get_thread_num();
+            int my_begin = begin[my_rank];
+            int my_end = begin[my_rank + 1];
+
+            for (;;) {
+                int my_next = 0;
+                for (int k = 0; k < frontier_size; ++k) {
+                    int u = frontier[k];
+                    int du = dist[u];
+                    if (du >= limit)
+                        continue;
+                    const int *row = mat + (size_t) u * n;
+                    for (int v = my_begin; v < my_end; ++v) {
+                        int weight = row[v];
+                        int dv = dist[v];
+                        if (weight < INF && du + weight < dv && du + weight < limit) {
+                            // dist only decreases, so INF means not touched yet
+                            if (dv == INF)
+                                touched[my_begin + touched_count[my_rank]++] = v;
+                            dist[v] = du + weight;
+                            if (!in_next[v]) {
+                                in_next[v] = true;
+                                next[my_begin + my_next++] = v;
+                                if (++relaxed_rounds[v] == n)
+                                    *has_negative_cycle = true;
+                            }
+                            if (v == source && dist[v] < 0)
+                                *has_negative_cycle = true;
+                        }
+                    }
+                }
+                next_count[my_rank] = my_next;
+                #pragma omp barrier
+                #pragma omp single
+                {
+                    // offsets of the per-thread segments in the new frontier
+                    frontier_size = 0;
+                    for (int t = 0; t < p; ++t) {
+                        int c = next_count[t];
+                        next_count[t] = frontier_size;
+                        frontier_size += c;
+                    }
+                    limit = cutoff(q);
+                }
+                // implicit barrier of single
+                // in_next is cleared even on the last round, or a vertex left marked by a query
+                // that found a negative cycle would never enter the frontier of the next one
+                int offset = next_count[my_rank];
+                int my_size = (my_rank + 1 < p ? next_count[my_rank + 1] : frontier_size) - offset;
+                for (int k = 0; k < my_size; ++k) {
+                    int v = next[my_begin + k];
+                    in_next[v] = false;
+                    frontier[offset + k] = v;
+                }
+                if (frontier_size == 0 || *has_negative_cycle)
+                    break;
+                #pragma omp barrier
+            }
+        }
+    }
+
+    /**
+     * ActiveQueue is a bounded multi-producer multi-consumer ring of vertices (D. Vyukov's design):
+     * every cell carries a sequence number telling whether it is ready to be written or read.
+     */
+    class ActiveQueue {
+    public:
+        //capacity is rounded up to a power of 2
+        explicit ActiveQueue(int capacity) {
+            size_t c = 1;
+            while (c < (size_t) capacity)
+                c <<= 1;
+            mask = c - 1;
+            cells.reset(new Cell[c]);
+            clear();
+        }
+
+        //not thread-safe, only between runs
+        void clear() {
+            for (size_t i = 0; i <= mask; ++i)
+                cells[i].seq.store(i, std::memory_order_relaxed);
+            head.store(0, std::memory_order_relaxed);
+            tail.store(0, std::memory_order_relaxed);
+        }
+
+        bool push(int v) {
+            size_t pos = tail.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell &cell = cells[pos & mask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+                if (diff == 0) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.v = v;
+                        cell.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(int &v) {
+            size_t pos = head.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell &cell = cells[pos & mask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+                if (diff == 0) {
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        v = cell.v;
+                        cell.seq.store(pos + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> seq;
+            int v;
+        };
+        std::unique_ptr<Cell[]> cells;
+        size_t mask;
+        // keep the consumer and the producer indices on separate cache lines
+        char pad0[64];
+        std::atomic<size_t> head;
+        char pad1[64];
+        std::atomic<size_t> tail;
+    };
+
+    /**
+     * AsyncSolver runs Bellman-Ford as a chaotic relaxation without rounds.
+     * Thread t owns the vertices [begin[t], begin[t + 1]) and relaxes their out-edges into all
+     * vertices. A vertex's distance and hop count are packed into one 64-bit atomic and lowered
+     * with compare-and-swap, so the latest distances are always visible to every thread. A vertex
+     * whose distance drops is put into the active queue of its owner unless it is already there.
+     *
+     * The run ends by quiescence detection: pending counts the vertices that are queued or being
+     * relaxed. A vertex is counted before it is queued and uncounted only after all the vertices it
+     * activated have been counted, so pending drops to 0 exactly when no work is left anywhere.
+     * A path of n hops means a negative cycle.
+     *
+     * A query resets all n vertices; targets are not used for pruning, only the bound is.
+     */
+    class AsyncSolver {
+    public:
+        AsyncSolver(const Graph &graph, int p)
+                : g(graph), p(p), begin(p + 1), dist(graph.size()),
+                  state(new std::atomic<uint64_t>[graph.size()]), queued(new std::atomic<bool>[graph.size()]) {
+            assert(p > 0);
+            int n = g.size();
+            int q = n / p, r = n % p;
+            begin[0] = 0;
+            for (int i = 1; i <= p; ++i)
+                begin[i] = begin[i - 1] + q + ((i - 1 < r) ? 1 : 0);
+            for (int t = 0; t < p; ++t)
+                queues.emplace_back(new ActiveQueue(std::max(1, begin[t + 1] - begin[t])));
+            omp_set_dynamic(0);
+        }
+
+        AsyncSolver(const AsyncSolver &) = delete;
+        AsyncSolver &operator=(const AsyncSolver &) = delete;
+
+        int num_threads() const { return p; }
+        const Graph &graph() const { return g; }
+
+        const int *query(int source, bool *has_negative_cycle) {
+            return query(Query(source), has_negative_cycle);
+        }
+
+        const int *query(const Query &q, bool *has_negative_cycle);
+
+    private:
+        const Graph &g;
+        int p;
+        std::vector<int> begin;
+        std::vector<int> dist;
+        std::unique_ptr<std::atomic<uint64_t>[]> state;    // distance << 32 | hops
+        std::unique_ptr<std::atomic<bool>[]> queued;
+        std::vector<std::unique_ptr<ActiveQueue>> queues;
+        alignas(64) std::atomic<long> pending;
+        alignas(64) std::atomic<bool> negative_cycle;
+
+        static uint64_t pack(int d, int hops) { return (uint64_t) (uint32_t) d << 32 | (uint32_t) hops; }
+        static int distance(uint64_t s) { return (int) (uint32_t) (s >> 32); }
+        static int hops(uint64_t s) { return (int) (uint32_t) s; }
+
+        int owner(int v) const {
+            return (int) (std::upper_bound(begin.begin(), begin.end(), v) - begin.begin()) - 1;
+        }
+
+        void activate(int v) {
+            // seq_cst, paired with the clearing in query(): see there
+            if (!queued[v].exchange(true, std::memory_order_seq_cst)) {
+                pending.fetch_add(1, std::memory_order_relaxed);
+                // cannot fail: a vertex is in at most one queue once, and its owner's queue holds all
+                queues[owner(v)]->push(v);
+            }
+        }
+    };
+
+    inline const int *AsyncSolver::query(const Query &q, bool *has_negative_cycle) {
+        const int n = g.size();
+        const int *mat = g.matrix();
+        const int source = q.source;
+        assert(0 <= source && source < n);
+        // without negative edges no relaxation beyond the bound can lead back under it
+        const int limit = g.has_negative_edge() || q.bound >= INF ? std::numeric_limits<int>::max() : q.bound + 1;
+
+        for (int t = 0; t < p; ++t)
+            queues[t]->clear();
+        pending.store(0);
+        negative_cycle.store(false);
+
+        #pragma omp parallel num_threads(p)
+        {
+            int my_rank = omp_get_thread_num();
+            for (int v = begin[my_rank]; v < begin[my_rank + 1]; ++v) {
+                state[v].store(pack(INF, 0), std::memory_order_relaxed);
+                queued[v].store(false, std::memory_order_relaxed);
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                state[source].store(pack(0, 0));
+                activate(source);
+            }
+            // implicit barrier of single
+
+            ActiveQueue &mine = *queues[my_rank];
+            int idle = 0;
+            while (!negative_cycle.load(std::memory_order_relaxed)) {
+                int u;
+                if (!mine.pop(u)) {
+                    if (pending.load(std::memory_order_acquire) == 0)
+                        break;
+                    if (++idle > 64)
+                        std::this_thread::yield();
+                    continue;
+                }
+                idle = 0;
+                // later improvements of u must queue it again. Clearing the flag and then
+                // reading the distance is a store followed by a load, which acquire/release does
+                // not order against an improver's CAS followed by its exchange in activate();
+                // with all four seq_cst, either this load sees the improvement or the improver
+                // sees the flag cleared and queues u again, so no relaxation is lost
+                queued[u].exchange(false, std::memory_order_seq_cst);
+                uint64_t su = state[u].load(std::memory_order_seq_cst);
+                int du = distance(su), hu = hops(su);
+                if (du < limit) {
+                    const int *row = mat + (size_t) u * n;
+                    for (int v = 0; v < n; ++v) {
+                        int weight = row[v];
+                        if (weight >= INF)
+                            continue;
+                        int dv = du + weight;
+                        if (dv >= limit)
+                            continue;
+                        uint64_t sv = state[v].load(std::memory_order_relaxed);
+                        while (dv < distance(sv)) {
+                            if (state[v].compare_exchange_weak(sv, pack(dv, hu + 1), std::memory_order_seq_cst,
+                                                               std::memory_order_relaxed)) {
+                                if (hu + 1 >= n || (v == source && dv < 0))
+                                    negative_cycle.store(true, std::memory_order_relaxed);
+                                activate(v);
+                                break;
+                            }
+                        }
+                    }
+                }
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            #pragma omp barrier
+            for (int v = begin[my_rank]; v < begin[my_rank + 1]; ++v) {
+                int d = distance(state[v].load(std::memory_order_relaxed));
+                dist[v] = d > q.bound ? INF : d;
+            }
+        }
+
+        *has_negative_cycle = negative_cycle.load();
+        return dist.data();
+    }
+
+}//namespace bf
+
+#endif
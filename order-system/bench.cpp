@@ -0,0 +1,150 @@
+// Throughput benchmark of the order system under saturating load
+
+// Runs the whole system (traders, processing thread, logger) once for every
+// combination of trader count, rate limit and wait strategy, quietly, and reports
+// for each run the sustained throughput (orders sent per second), the peak depth
+// of the [to_send] queues (of any venue), and percentiles of trader submit
+// latency, of the processing time per pass, of the wait of orders from creation to
+// sending, the longest gap between passes that sent, and, with --exchange=path,
+// percentiles of the round trip of orders to the exchange and back. "unlimited"
+// sets a limit no run can reach, to measure the raw capacity of the pipeline. With
+// --json=path, every run is also written with its full report (as order
+// --json=path) into a JSON array.
+
+// To compile: g++ bench.cpp -fopenmp -std=c++17 -O2 -o bench
+
+// To run, for example:
+//   bench --traders=3,10,30,100 --limits=unlimited,10000/100 --orders=100000
+//         --cycle=0 --waits=spin,yield,futex,condvar --json=bench.json
+
+// Options not listed here (e.g. --sim, --clock=tsc) are passed on to every run.
+
+#define ORDER_NO_MAIN
+#include "order.cpp"
+
+#include <cstdio>
+
+// split "a,b,c"
+static vector<string> split(const string & s)
+{
+    vector<string> parts;
+    std::istringstream iss(s);
+    for (string part; getline(iss, part, ','); )
+        if (!part.empty())
+            parts.push_back(part);
+    return parts;
+}
+
+int main(int argc, char * argv[])
+{
+    vector<string> traders = {"3", "10", "30", "100"};
+    vector<string> limits = {"unlimited", "10000/100"};
+    vector<string> waits = {"spin", "yield", "futex", "condvar"};
+    vector<string> paces = {"0"};
+    string orders = "100000", cycle = "0", json;
+    vector<string> passed;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const auto eq = arg.find('=');
+        const string name = arg.substr(0, eq), value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (name == "--traders")
+            traders = split(value);
+        else if (name == "--limits")
+            limits = split(value);
+        else if (name == "--waits")
+            waits = split(value);
+        else if (name == "--paces")
+            paces = split(value);
+        else if (name == "--orders")
+            orders = value;
+        else if (name == "--cycle")
+            cycle = value;
+        else if (name == "--json")
+            json = value;
+        else
+            passed.push_back(arg);
+    }
+
+    std::ofstream js;
+    if (!json.empty()) {
+        js.open(json);
+        js << "[\n";
+    }
+    const string sent_file = "bench-sent.bin";
+
+    cout << "orders " << orders << ", cycle " << cycle << " ms, hardware threads "
+         << std::thread::hardware_concurrency() << endl;
+    cout << std::left << std::setw(9) << "traders" << std::setw(12) << "limit" << std::setw(9) << "wait"
+         << std::setw(6) << "pace"
+         << std::right << std::setw(12) << "orders/s" << std::setw(10) << "depth"
+         << std::setw(12) << "submit p50" << std::setw(12) << "p99" << std::setw(12) << "p99.9"
+         << std::setw(14) << "dispatch p50" << std::setw(12) << "p99" << std::setw(12) << "p99.9"
+         << std::setw(14) << "wait p50" << std::setw(14) << "p99" << std::setw(14) << "max gap"
+         << std::setw(12) << "rtt p50" << std::setw(12) << "p99"
+         << "  (ns)" << endl;
+
+    bool first = true;
+    for (const auto & ntr : traders)
+        for (const auto & limit : limits)
+            for (const auto & wait : waits)
+            for (const auto & pace : paces) {
+                vector<string> options = {"--orders=" + orders, "--traders=" + ntr,
+                                          "--cycle=" + cycle, "--wait=" + wait, "--quiet",
+                                          "--sent-file=" + sent_file};
+                if (pace != "0")
+                    options.push_back("--pace=" + pace);
+                if (limit == "unlimited")
+                    options.push_back("--max=" + orders);       // never reached
+                else {
+                    const auto slash = limit.find('/');
+                    options.push_back("--max=" + limit.substr(0, slash));
+                    options.push_back("--len=" + limit.substr(slash + 1));
+                }
+                options.insert(options.end(), passed.begin(), passed.end());
+
+                Spec spec;
+                spec.parse(options);
+                {
+                    System sys(spec);
+                    sys.start();
+                    const auto submit = sys.get_submit_latency();
+                    const auto dispatch = sys.get_dispatch_latency();
+                    const auto wait_hist = sys.get_wait_latency();
+                    const auto round_trip = sys.get_round_trip();
+                    std::int64_t depth = 0;
+                    Time gap = Time::zero();
+                    for (int v = 0; v != sys.get_num_venues(); ++v) {
+                        depth = std::max(depth, sys.get_queue_depth(v).get_max());
+                        gap = std::max(gap, sys.get_send_gaps(v).get_max());
+                    }
+                    cout << std::left << std::setw(9) << ntr << std::setw(12) << limit
+                         << std::setw(9) << wait << std::setw(6) << pace
+                         << std::right << fixed << setprecision(0)
+                         << std::setw(12) << sys.get_throughput()
+                         << std::setw(10) << depth
+                         << std::setw(12) << submit.percentile(0.5).count()
+                         << std::setw(12) << submit.percentile(0.99).count()
+                         << std::setw(12) << submit.percentile(0.999).count()
+                         << std::setw(14) << dispatch.percentile(0.5).count()
+                         << std::setw(12) << dispatch.percentile(0.99).count()
+                         << std::setw(12) << dispatch.percentile(0.999).count()
+                         << std::setw(14) << wait_hist.percentile(0.5).count()
+                         << std::setw(14) << wait_hist.percentile(0.99).count()
+                         << std::setw(14) << gap.count()
+                         << std::setw(12) << round_trip.percentile(0.5).count()
+                         << std::setw(12) << round_trip.percentile(0.99).count() << endl;
+                    if (js.is_open()) {
+                        js << (first ? "" : ",\n");
+                        sys.export_json(js);
+                        first = false;
+                    }
+                }
+                std::remove(sent_file.c_str());
+                for (int v = 1; v <= 16; ++v)           // those of several venues
+                    std::remove((sent_file + "." + std::to_string(v)).c_str());
+            }
+
+    if (js.is_open())
+        js << "]\n";
+    return 0;
+}
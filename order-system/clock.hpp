@@ -0,0 +1,175 @@
+// Time sources of the order system
+
+// [Time] a strongly typed duration in nanoseconds. Points in time are durations
+// since the epoch of the clock in use (see Order::get_time_now for run time).
+
+// [Clock] the interface: now(), and precise sleep_until() / sleep_for().
+
+// [SteadyClock] CLOCK_MONOTONIC: wall time, never jumps, unaffected by busy threads.
+
+// [TscClock] the CPU time stamp counter, calibrated against CLOCK_MONOTONIC once at
+//            start; cheaper to read, but only sound on CPUs with an invariant TSC.
+
+// [VirtualClock] time moves only when told to; sleeping advances it. For tests and
+//                simulation.
+
+// A precise sleep hands the bulk of a wait to the kernel (clock_nanosleep) and
+// spins for the last SPIN_WINDOW, since the kernel may wake a thread late by tens
+// of microseconds.
+
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ORDER_HAS_TSC 1
+#endif
+
+using Time = std::chrono::nanoseconds;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+constexpr Time INF = Time::max();
+constexpr Time SPIN_WINDOW = microseconds(100);
+
+inline long long to_ms(Time t)
+{
+    return std::chrono::duration_cast<milliseconds>(t).count();
+}
+
+// a hint to the CPU that we are busy waiting
+inline void cpu_relax()
+{
+#ifdef ORDER_HAS_TSC
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+inline Time monotonic_now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return seconds(ts.tv_sec) + Time(ts.tv_nsec);
+}
+
+// sleep until CLOCK_MONOTONIC reads t, immune to early wake-ups by signals
+inline void monotonic_sleep_until(Time t)
+{
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(t.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(t.count() % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) != 0)
+        ;
+}
+
+class Clock
+{
+public:
+
+    virtual ~Clock() = default;
+    virtual Time now() const = 0;
+    virtual const char * name() const = 0;
+
+    // sleep in the kernel until SPIN_WINDOW before t, then spin
+    virtual void sleep_until(Time t) const
+    {
+        Time left = t - now();
+        if (left > SPIN_WINDOW)
+            monotonic_sleep_until(monotonic_now() + left - SPIN_WINDOW);
+        spin_until(t);
+    }
+    void sleep_for(Time d) const            { sleep_until(now() + d); }
+    virtual void spin_until(Time t) const
+    {
+        while (now() < t)
+            cpu_relax();
+    }
+};
+
+class SteadyClock : public Clock
+{
+public:
+
+    Time now() const override               { return monotonic_now(); }
+    const char * name() const override      { return "steady"; }
+    void sleep_until(Time t) const override
+    {
+        if (t - now() > SPIN_WINDOW)
+            monotonic_sleep_until(t - SPIN_WINDOW);
+        spin_until(t);
+    }
+};
+
+#ifdef ORDER_HAS_TSC
+class TscClock : public Clock
+{
+    std::uint64_t   tsc0;
+    Time            mono0;
+    double          ns_per_tick;
+
+public:
+
+    // calibrate over the given period by reading both clocks at its ends
+    explicit TscClock(Time period = milliseconds(20))
+    {
+        tsc0 = __rdtsc();
+        mono0 = monotonic_now();
+        monotonic_sleep_until(mono0 + period);
+        const auto tsc1 = __rdtsc();
+        const auto mono1 = monotonic_now();
+        ns_per_tick = static_cast<double>((mono1 - mono0).count()) / (tsc1 - tsc0);
+    }
+    Time now() const override
+    {
+        return mono0 + Time(static_cast<std::int64_t>((__rdtsc() - tsc0) * ns_per_tick));
+    }
+    const char * name() const override      { return "tsc"; }
+    double get_ghz() const                  { return 1 / ns_per_tick; }
+};
+#endif
+
+class VirtualClock : public Clock
+{
+    std::atomic<std::int64_t> t{0};
+
+public:
+
+    Time now() const override               { return Time(t.load(std::memory_order_acquire)); }
+    const char * name() const override      { return "virtual"; }
+    void sleep_until(Time u) const override { const_cast<VirtualClock *>(this)->advance_to(u); }
+    void spin_until(Time u) const override  { const_cast<VirtualClock *>(this)->advance_to(u); }
+
+    // move forward to u, never backward
+    void advance_to(Time u)
+    {
+        auto c = t.load(std::memory_order_relaxed);
+        while (c < u.count() && !t.compare_exchange_weak(c, u.count(), std::memory_order_acq_rel))
+            ;
+    }
+    void advance(Time d)                    { t.fetch_add(d.count(), std::memory_order_acq_rel); }
+};
+
+// "steady", "tsc" or "virtual"; falls back to steady without a TSC
+inline std::unique_ptr<Clock> make_clock(const std::string & name)
+{
+#ifdef ORDER_HAS_TSC
+    if (name == "tsc")
+        return std::unique_ptr<Clock>(new TscClock);
+#endif
+    if (name == "virtual")
+        return std::unique_ptr<Clock>(new VirtualClock);
+    return std::unique_ptr<Clock>(new SteadyClock);
+}
+
+#endif
@@ -0,0 +1,45 @@
+// Decoder of the binary event log of the order system
+
+// Turns the file written with --log=path back into the lines printed in real time;
+// a journal (--journal=path) too, with a line for the beginning and the end of each
+// run.
+
+// To compile: g++ decode.cpp -std=c++17 -O2 -o decode
+
+// To run: decode <log file>
+
+#include <cstdio>
+#include <iostream>
+
+#include "log.hpp"
+
+int main(int argc, char * argv[])
+{
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <log file>" << std::endl;
+        return 1;
+    }
+    std::FILE * in = std::fopen(argv[1], "rb");
+    if (!in) {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    LogRecord records[1024];
+    char line[256];
+    std::size_t n, total = 0;
+    while ((n = std::fread(records, sizeof(LogRecord), 1024, in)) > 0) {
+        for (std::size_t i = 0; i != n; ++i) {
+            const int len = format(records[i], line, sizeof line);
+            std::fwrite(line, 1, static_cast<std::size_t>(len), stdout);
+        }
+        total += n;
+    }
+    const bool torn = !std::feof(in) || std::ftell(in) != static_cast<long>(total * sizeof(LogRecord));
+    std::fclose(in);
+    if (torn) {
+        std::cerr << argv[1] << ": trailing bytes after " << total << " records" << std::endl;
+        return 1;
+    }
+    return 0;
+}
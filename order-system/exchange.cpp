@@ -0,0 +1,166 @@
+// Mock exchange for the order system
+
+// Listens on a Unix-domain socket and treats each connection as a session, one per
+// venue of a run of order --exchange=path. It reads the orders (WireOrder, see
+// wire.hpp) and acks each one (WireAck): accepted, or rejected if it breaks a limit
+// of the exchange's own windows. The windows are checked at the time an order is
+// received, by an Audit (limiter.hpp) per session, independently of the sender's
+// Limiter; as at a real venue, only the orders accepted count in them. A session
+// ends when the sender shuts down its side. The exchange then closes it after the
+// last ack and prints what it received.
+
+// Single-threaded: a poll() loop over the listening socket and the sessions. The
+// acks of what one read() brought are written in one send.
+
+// To compile: g++ exchange.cpp -std=c++17 -O2 -o exchange
+
+// To run, for example:
+//   exchange --socket=/tmp/exchange.sock --limit=10/1000 --sessions=1 &
+//   order --exchange=/tmp/exchange.sock
+
+// Options:
+//   --socket=path       (default exchange.sock)
+//   --limit=MAX/LEN     (at most MAX orders in any LEN ms; repeat for more limits;
+//                        default 10/1000, as the order system's default spec)
+//   --sessions=N        (exit once N sessions have ended; default never)
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "limiter.hpp"
+#include "wire.hpp"
+
+struct Session
+{
+    static constexpr std::size_t BATCH = 1024;      // orders read at once
+
+    int             fd;
+    int             number;
+    Audit           audit;
+    WireOrder       orders[BATCH];
+    WireAck         acks[BATCH];
+    std::size_t     have = 0;                       // bytes of orders read
+    std::size_t     received = 0;
+    std::size_t     rejected = 0;
+    int             venue = 0;
+
+    Session(int f, int n, const std::vector<Rule> & rules) : fd(f), number(n), audit(rules) {}
+
+    // read what came and ack it; false once the sender is done or gone
+    bool serve()
+    {
+        const ssize_t got = ::read(fd, reinterpret_cast<char *>(orders) + have, sizeof orders - have);
+        if (got < 0 && errno == EINTR)
+            return true;
+        if (got <= 0)
+            return false;
+        const Time now = monotonic_now();
+        have += static_cast<std::size_t>(got);
+        const std::size_t n = have / sizeof(WireOrder);
+        for (std::size_t i = 0; i != n; ++i) {
+            const bool broke = !audit.admit(now);
+            acks[i] = WireAck{orders[i].type, broke ? WireAck::REJECTED : WireAck::ACCEPTED, 0,
+                              orders[i].id, orders[i].sent};
+            rejected += broke;
+            venue = orders[i].venue;
+        }
+        received += n;
+        have -= n * sizeof(WireOrder);
+        std::memmove(orders, orders + n, have);
+        iovec iov{acks, n * sizeof(WireAck)};
+        return n == 0 || send_all(fd, &iov, 1);
+    }
+};
+
+int main(int argc, char * argv[])
+{
+    std::string path = "exchange.sock";
+    std::vector<Rule> rules;
+    long sessions_to_serve = -1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        const std::string name = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        std::istringstream iss(value);
+        std::size_t max;
+        long long len;
+        char slash;
+        if (name == "--socket" && !value.empty())
+            path = value;
+        else if (name == "--limit" && iss >> max >> slash >> len && slash == '/' && max && len > 0)
+            rules.push_back(Rule{max, milliseconds(len)});
+        else if (name == "--sessions" && std::atol(value.c_str()) > 0)
+            sessions_to_serve = std::atol(value.c_str());
+        else
+            std::cout << "Ignored option " << arg << std::endl;
+    }
+    if (rules.empty())
+        rules.push_back(Rule{10, seconds(1)});
+
+    sockaddr_un address;
+    if (!unix_address(path, address)) {
+        std::cerr << path << ": socket path too long" << std::endl;
+        return 1;
+    }
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ::unlink(path.c_str());
+    if (listener < 0 || ::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof address) < 0
+        || ::listen(listener, 16) < 0) {
+        std::perror(path.c_str());
+        return 1;
+    }
+    std::cout << "Exchange listening on " << path << ", limits";
+    for (const auto & rule : rules)
+        std::cout << " " << rule.max << " in " << rule.len.count() / 1e6 << " ms";
+    std::cout << std::endl;
+
+    std::vector<std::unique_ptr<Session>> sessions;
+    int opened = 0;
+    long ended = 0;
+    while (sessions_to_serve < 0 || ended < sessions_to_serve) {
+        std::vector<pollfd> fds{{listener, POLLIN, 0}};
+        for (const auto & s : sessions)
+            fds.push_back(pollfd{s->fd, POLLIN, 0});
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::perror("poll");
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            const int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0)
+                sessions.emplace_back(new Session(fd, ++opened, rules));
+        }
+        for (std::size_t i = fds.size() - 1; i != 0; --i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            Session & s = *sessions[i - 1];
+            if (s.serve())
+                continue;
+            std::cout << "Session # " << s.number;
+            if (s.venue)
+                std::cout << " (venue # " << s.venue << ")";
+            std::cout << "\treceived " << s.received << " orders, rejected " << s.rejected
+                      << " for violating a limit" << std::endl;
+            ::close(s.fd);
+            sessions.erase(sessions.begin() + static_cast<std::ptrdiff_t>(i - 1));
+            ++ended;
+        }
+    }
+    ::close(listener);
+    ::unlink(path.c_str());
+    return 0;
+}
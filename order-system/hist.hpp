@@ -0,0 +1,153 @@
+// Latency histograms of the order system
+
+// [Histogram] counts durations in log-linear buckets, in the manner of HDR
+//             histograms: values below 2^SUB_BITS ns each have a bucket, and every
+//             range [2^e, 2^(e+1)) above is cut into 2^SUB_BITS buckets of equal
+//             width, so a percentile is off by at most 1 / 2^SUB_BITS (about 3%).
+//             Memory is fixed (about 15 KB) and recording is a few instructions.
+
+// [Series] samples of a value over time, e.g. a queue depth, in fixed memory: when
+//          it is full, every other sample is dropped and the interval doubles.
+
+// A histogram or series has one writer: each thread records into its own, and they are
+// merged for the report after the threads are done, so recording takes no lock
+// and no atomic.
+
+#ifndef HIST_HPP
+#define HIST_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "clock.hpp"
+
+class Histogram
+{
+    static constexpr int            SUB_BITS = 5;
+    static constexpr std::int64_t   SUB      = 1 << SUB_BITS;
+    static constexpr std::size_t    BUCKETS  = (64 - SUB_BITS) * SUB;
+
+    std::vector<std::uint64_t>  counts;
+    std::uint64_t               total = 0;
+    std::int64_t                max   = 0;
+
+    static std::size_t index(std::int64_t v)
+    {
+        if (v < SUB)
+            return static_cast<std::size_t>(v);
+        const int e = 63 - __builtin_clzll(static_cast<unsigned long long>(v));
+        const int shift = e - SUB_BITS;
+        return static_cast<std::size_t>((shift + 1) * SUB + ((v >> shift) - SUB));
+    }
+
+    // the highest value counted in bucket i
+    static std::int64_t highest(std::size_t i)
+    {
+        if (i < static_cast<std::size_t>(SUB))
+            return static_cast<std::int64_t>(i);
+        const int shift = static_cast<int>(i / SUB) - 1;
+        const std::int64_t lowest = (SUB + static_cast<std::int64_t>(i % SUB)) << shift;
+        return lowest + (std::int64_t(1) << shift) - 1;
+    }
+
+public:
+
+    Histogram() : counts(BUCKETS) {}
+
+    void record(Time t)
+    {
+        const std::int64_t v = std::max<std::int64_t>(t.count(), 0);
+        ++counts[index(v)];
+        ++total;
+        max = std::max(max, v);
+    }
+
+    void merge(const Histogram & h)
+    {
+        for (std::size_t i = 0; i != BUCKETS; ++i)
+            counts[i] += h.counts[i];
+        total += h.total;
+        max = std::max(max, h.max);
+    }
+
+    std::uint64_t count() const     { return total;     }
+    Time get_max() const            { return Time(max); }
+
+    // the value below which a fraction q of the records fall, q in [0, 1]
+    Time percentile(double q) const
+    {
+        if (total == 0)
+            return Time::zero();
+        const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(q * total + 0.5));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i != BUCKETS; ++i)
+            if ((seen += counts[i]) >= rank)
+                return Time(std::min(highest(i), max));
+        return Time(max);
+    }
+};
+
+class Series
+{
+    std::vector<std::pair<Time, std::int64_t>> samples;
+    std::size_t     capacity;
+    Time            every;          // interval between samples
+    Time            next = Time::zero();
+    std::int64_t    max = 0;
+
+public:
+
+    explicit Series(Time interval, std::size_t n = 1024)
+        : capacity(std::max<std::size_t>(n, 2)), every(interval)
+    {
+        samples.reserve(capacity);
+    }
+
+    // whether a sample is due at t; the caller computes the value only if so
+    bool due(Time t) const          { return t >= next; }
+
+    void record(Time t, std::int64_t v)
+    {
+        max = std::max(max, v);
+        if (samples.size() == capacity) {
+            for (std::size_t i = 0; i != capacity / 2; ++i)
+                samples[i] = samples[2 * i];
+            samples.resize(capacity / 2);
+            every *= 2;
+        }
+        samples.emplace_back(t, v);
+        next = t + every;
+    }
+
+    std::int64_t get_max() const    { return max; }
+    const std::vector<std::pair<Time, std::int64_t>> & get_samples() const { return samples; }
+};
+
+// the percentiles reported, and their names
+constexpr double        PERCENTILES[]       = { 0.5, 0.9, 0.99, 0.999 };
+constexpr const char *  PERCENTILE_NAMES[]  = { "p50", "p90", "p99", "p99.9" };
+
+// {"count": n, "p50": ns, "p90": ns, "p99": ns, "p99.9": ns, "max": ns}
+inline void to_json(std::ostream & os, const Histogram & h)
+{
+    os << "{\"count\": " << h.count();
+    for (std::size_t i = 0; i != sizeof PERCENTILES / sizeof *PERCENTILES; ++i)
+        os << ", \"" << PERCENTILE_NAMES[i] << "\": " << h.percentile(PERCENTILES[i]).count();
+    os << ", \"max\": " << h.get_max().count() << "}";
+}
+
+// {"max": v, "samples": [[ns, v], ...]}
+inline void to_json(std::ostream & os, const Series & s)
+{
+    os << "{\"max\": " << s.get_max() << ", \"samples\": [";
+    const auto & samples = s.get_samples();
+    for (std::size_t i = 0; i != samples.size(); ++i)
+        os << (i ? ", " : "") << "[" << samples[i].first.count() << ", " << samples[i].second << "]";
+    os << "]}";
+}
+
+#endif
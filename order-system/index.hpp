@@ -0,0 +1,96 @@
+// An index of queued elements by id
+
+// [SlotIndex] maps the ids of the last n elements a producer pushed to their slots in
+// its queues, in O(1): open addressing with linear probing in a table of 2n or more
+// entries, fixed at construction, and deletion by backward shift, so that there is
+// no tombstone and lookups stay short. When n ids are indexed, inserting forgets
+// the oldest. An entry may outlive its element: the caller checks that the slot
+// still holds the id, and the element's own state says whether it is still queued.
+
+#ifndef INDEX_HPP
+#define INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "queue.hpp"
+
+template<typename T>
+class SlotIndex
+{
+    struct Entry
+    {
+        std::uint64_t   id = 0;         // 0 for none
+        T *             slot = nullptr;
+    };
+
+    std::vector<Entry>          table;
+    const std::size_t           mask;
+    std::vector<std::uint64_t>  recent_ids; // ids indexed, oldest at next once full
+    std::size_t                 next = 0;
+    std::size_t                 count = 0;
+
+    std::size_t home(std::uint64_t id) const
+    {
+        return static_cast<std::size_t>(id * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    }
+
+    void erase(std::uint64_t id)
+    {
+        std::size_t i = home(id);
+        while (table[i].id != id) {
+            if (table[i].id == 0)
+                return;
+            i = (i + 1) & mask;
+        }
+        // shift back the entries of the run after i that may move into the hole
+        for (std::size_t j = (i + 1) & mask; table[j].id; j = (j + 1) & mask) {
+            const std::size_t h = home(table[j].id);
+            if (((j - h) & mask) >= ((j - i) & mask)) {
+                table[i] = table[j];
+                i = j;
+            }
+        }
+        table[i] = Entry();
+    }
+
+public:
+
+    explicit SlotIndex(std::size_t n)
+        : table(ring_capacity(2 * (n ? n : 1))), mask(table.size() - 1), recent_ids(n ? n : 1) {}
+
+    // nullptr if id is not indexed
+    T * find(std::uint64_t id) const
+    {
+        for (std::size_t i = home(id); table[i].id; i = (i + 1) & mask)
+            if (table[i].id == id)
+                return table[i].slot;
+        return nullptr;
+    }
+
+    // id is not indexed yet, and not 0
+    void insert(std::uint64_t id, T * slot)
+    {
+        if (count == recent_ids.size())
+            erase(recent_ids[next]);
+        else
+            ++count;
+        recent_ids[next] = id;
+        next = next + 1 == recent_ids.size() ? 0 : next + 1;
+        std::size_t i = home(id);
+        while (table[i].id)
+            i = (i + 1) & mask;
+        table[i] = Entry{id, slot};
+    }
+
+    std::size_t size() const        { return count; }
+
+    // the k-th id indexed from last, k < size()
+    std::uint64_t recent(std::size_t k) const
+    {
+        return recent_ids[(next + recent_ids.size() - 1 - k) % recent_ids.size()];
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+// Recovery of the order system from its journal
+
+// [Journal] the binary log written with --journal=path: the LogRecords of the events
+//           of every run, appended, each run headed by a BEGIN record that gives the
+//           real time (CLOCK_REALTIME) its times count from, and closed by an END
+//           record once all of it is committed. The Logger commits the records in
+//           groups, one fdatasync() per batch it writes, on its own thread, so no
+//           trader or dispatcher ever waits for the disk; what was logged after the
+//           last commit may be lost in a crash, sends included.
+
+// [Recovery] what replay() folds the journal into, for a run to go on where the
+//            runs before it stopped: the orders created but neither sent nor
+//            cancelled, with their last amendment; the times of the sends to each
+//            venue, for its limiter; and the highest id, which new ids follow. The
+//            file is mapped and read in one pass, with one slot per id, and times
+//            are kept in real time. Records of different threads are not in the
+//            order of their events. A simulation's times are virtual, so its sends
+//            are not kept, and its orders count as created when it began. A
+//            torn record at the end, from a crash in the middle of a write, is
+//            ignored. A last run in real time without an END crashed, and the
+//            sends it made after its last commit are unknown: the windows cannot
+//            be known from the journal alone, nor whether its pending orders were
+//            sent. An order a run marked UNKNOWN for that reason is not pending.
+
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "log.hpp"
+
+// ns since 1970
+inline std::int64_t realtime_now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct Recovery
+{
+    struct Pending
+    {
+        std::uint64_t   id;
+        std::int32_t    trader;         // from 1
+        std::int16_t    venue;          // from 1, or 0 if the run had one
+        std::int16_t    urgent;
+        std::int64_t    created;        // ns since 1970
+        std::int64_t    quantity;
+        std::int64_t    price;
+    };
+
+    std::vector<Pending>    pending;                // by id
+    std::vector<std::vector<std::int64_t>> sends;   // ns since 1970, by venue field
+    std::uint64_t           last_id = 0;
+    bool                    cut     = false;        // the last run crashed in real time
+    std::size_t             events  = 0;            // records read, BEGIN aside
+    std::size_t             runs    = 0;
+    std::size_t             bytes   = 0;
+    Time                    took    = Time::zero(); // to map and fold the file
+    std::string             error;                  // why the journal was not read
+};
+
+// fold the journal at path; an absent or empty file is an empty journal
+inline Recovery replay(const std::string & path)
+{
+    enum : std::int8_t { NONE, QUEUED, GONE };
+    struct Slot                         // what is known of an order, by id
+    {
+        std::int8_t     state = NONE;
+        std::int8_t     urgent = 0;
+        std::int16_t    venue = 0;
+        std::int32_t    trader = 0;
+        std::int64_t    created = 0;
+        std::int64_t    quantity = 100;
+        std::int64_t    price = 10000;
+    };
+
+    Recovery r;
+    const Time start = monotonic_now();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT)
+            r.error = std::strerror(errno);
+        return r;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(LogRecord))) {
+        ::close(fd);
+        return r;
+    }
+    r.bytes = static_cast<std::size_t>(st.st_size);
+    void * map = ::mmap(nullptr, r.bytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        r.error = std::strerror(errno);
+        return r;
+    }
+    ::madvise(map, r.bytes, MADV_SEQUENTIAL);
+
+    const auto * records = static_cast<const LogRecord *>(map);
+    const std::size_t n = r.bytes / sizeof(LogRecord);
+    std::vector<Slot> slots;
+    std::int64_t epoch = 0;
+    bool simulated = false;
+    for (std::size_t i = 0; i != n; ++i) {
+        const LogRecord & e = records[i];
+        if (e.kind == LogRecord::BEGIN) {
+            epoch = e.time;
+            simulated = e.urgent;
+            r.cut = !simulated;
+            ++r.runs;
+            continue;
+        }
+        if (e.kind == LogRecord::END) {
+            r.cut = false;
+            continue;
+        }
+        ++r.events;
+        const std::int64_t at = simulated ? epoch : epoch + e.time;
+        if (e.id >= slots.size())
+            slots.resize(std::max<std::size_t>(e.id + 1, slots.size() * 2));
+        Slot & s = slots[e.id];
+        r.last_id = std::max<std::uint64_t>(r.last_id, e.id);
+        switch (e.kind) {
+            case LogRecord::CREATED:
+                // the lanes of the traders and the venues are written in turn, so
+                // the record of a send may come first
+                if (s.state == NONE)
+                    s.state = QUEUED;
+                s.urgent = static_cast<std::int8_t>(e.urgent);
+                s.venue = static_cast<std::int16_t>(e.until);
+                s.trader = e.trader;
+                s.created = at;
+                break;
+            case LogRecord::SENT:
+                if (!simulated) {
+                    if (static_cast<std::size_t>(e.until) >= r.sends.size())
+                        r.sends.resize(static_cast<std::size_t>(e.until) + 1);
+                    r.sends[static_cast<std::size_t>(e.until)].push_back(at);
+                }
+                s.state = GONE;
+                break;
+            case LogRecord::CANCELLED:
+            case LogRecord::UNKNOWN:
+                s.state = GONE;
+                break;
+            case LogRecord::AMENDED:
+                s.quantity = e.until >> 32;
+                s.price = static_cast<std::uint32_t>(e.until);
+                break;
+            default:
+                break;
+        }
+    }
+    ::munmap(map, r.bytes);
+
+    for (std::size_t id = 0; id != slots.size(); ++id)
+        if (slots[id].state == QUEUED) {
+            const Slot & s = slots[id];
+            r.pending.push_back(Recovery::Pending{id, s.trader, s.venue, s.urgent, s.created,
+                                                  s.quantity, s.price});
+        }
+    r.took = monotonic_now() - start;
+    return r;
+}
+
+#endif
@@ -0,0 +1,231 @@
+// Sliding-window rate limits of the order system
+
+// [Rule] at most max orders in any interval of length len, continuous in time: a
+//        send at t violates the rule if max orders were sent in (t - len, t].
+
+// [Limiter] enforces any number of rules at once. For each rule it keeps the times
+//           of the last max sends in a ring; the oldest of them is the max-th send
+//           from last, and { sending at t is allowed } is equivalent to { that send
+//           was at least len before t }. Memory is fixed, each query is O(rules);
+//           how many may be sent at once is O(rules * orders allowed). A number of
+//           places of each window may be kept free, for urgent orders.
+
+// [Pacer] spaces sends evenly, in the manner of the generic cell rate algorithm
+//         (GCRA): one per interval on average, the len / max of the tightest rule,
+//         and at most burst back to back. Instead of letting max orders out at
+//         once and then stalling for most of a window, a backlog leaves at the
+//         rate of the rules. It keeps a theoretical arrival time (TAT): sending at t
+//         conforms if t >= TAT - (burst - 1) * interval, and moves TAT to
+//         max(TAT, t) + interval. Used with a Limiter, which guarantees the rules.
+
+// [Audit] checks a stream of send times against the rules independently of the
+//         Limiter, counting violations, in a ring of max + 1 times per rule. Sends
+//         of an earlier run may be remembered, to check the first ones against.
+//         As an exchange, it may admit only the sends that keep to the rules, so
+//         that a refused one takes no place of the windows.
+
+#ifndef LIMITER_HPP
+#define LIMITER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "clock.hpp"
+
+struct Rule
+{
+    std::size_t max;
+    Time        len;
+};
+
+class Limiter
+{
+    struct Window
+    {
+        Rule                rule;
+        std::vector<Time>   ring;       // times of the last rule.max sends
+        std::size_t         next = 0;   // oldest once the ring is full
+        std::size_t         count = 0;
+    };
+
+    std::vector<Window> windows;
+
+public:
+
+    explicit Limiter(const std::vector<Rule> & rules)
+    {
+        for (const auto & r : rules)
+            windows.push_back(Window{r, std::vector<Time>(r.max), 0, 0});
+    }
+
+    // earliest time at or after t when one more order may be sent, leaving reserve
+    // places of each window free (at most max - 1); the (max - reserve)-th send from
+    // last must have left the window
+    Time earliest(Time t, std::size_t reserve = 0) const
+    {
+        for (const auto & w : windows) {
+            const std::size_t r = std::min(reserve, w.rule.max - 1);
+            if (w.count >= w.rule.max - r)
+                t = std::max(t, w.ring[(w.next + r) % w.rule.max] + w.rule.len);
+        }
+        return t;
+    }
+
+    // how many orders may be sent at t at once, at most want, leaving reserve places
+    // of each window free: for each rule, the free places in the ring and the sends
+    // that have left the window by t, less the reserve
+    std::size_t allowance(Time t, std::size_t want, std::size_t reserve = 0) const
+    {
+        for (const auto & w : windows) {
+            const std::size_t r = std::min(reserve, w.rule.max - 1);
+            const std::size_t oldest = (w.next + w.rule.max - w.count) % w.rule.max;
+            std::size_t expired = 0;
+            while (expired != w.count && w.rule.max + expired < want + r + w.count
+                   && w.ring[(oldest + expired) % w.rule.max] + w.rule.len <= t)
+                ++expired;
+            // sends in the window after sending n: count - expired + n <= max - r
+            const std::size_t room = w.rule.max - r + expired;
+            want = room > w.count ? std::min(want, room - w.count) : 0;
+        }
+        return want;
+    }
+
+    // an order was sent at t, no earlier than earliest(t) and any previous send
+    void record(Time t)
+    {
+        for (auto & w : windows) {
+            w.ring[w.next] = t;
+            w.next = w.next + 1 == w.rule.max ? 0 : w.next + 1;
+            w.count = std::min(w.count + 1, w.rule.max);
+        }
+    }
+
+    std::vector<Rule> get_rules() const
+    {
+        std::vector<Rule> rules;
+        for (const auto & w : windows)
+            rules.push_back(w.rule);
+        return rules;
+    }
+};
+
+class Pacer
+{
+    Time    interval  = Time::zero();   // zero if not pacing
+    Time    tolerance = Time::zero();   // (burst - 1) intervals
+    Time    tat       = Time::zero();
+
+public:
+
+    // burst 0 for no pacing
+    Pacer(const std::vector<Rule> & rules, std::size_t burst)
+    {
+        if (burst == 0)
+            return;
+        for (const auto & r : rules)
+            interval = std::max(interval, r.len / static_cast<Time::rep>(r.max));
+        tolerance = interval * static_cast<Time::rep>(burst - 1);
+    }
+
+    // earliest time at or after t when one more order conforms
+    Time earliest(Time t) const         { return std::max(t, tat - tolerance); }
+
+    // how many orders conform at t at once, at most want
+    std::size_t allowance(Time t, std::size_t want) const
+    {
+        if (interval == Time::zero())
+            return want;
+        const Time base = std::max(tat, t);
+        if (base - tolerance > t)
+            return 0;
+        return std::min<std::size_t>(want, (t + tolerance - base) / interval + 1);
+    }
+
+    void record(Time t)
+    {
+        if (interval != Time::zero())
+            tat = std::max(tat, t) + interval;
+    }
+};
+
+class Audit
+{
+    struct Window
+    {
+        Rule                rule;
+        std::vector<Time>   ring;       // sends within the last rule.len, and one more
+        std::size_t         head = 0;
+        std::size_t         count = 0;
+    };
+
+    std::vector<Window> windows;
+    std::size_t         checked = 0;
+    std::size_t         violations = 0;
+
+public:
+
+    explicit Audit(const std::vector<Rule> & rules)
+    {
+        for (const auto & r : rules)
+            windows.push_back(Window{r, std::vector<Time>(r.max + 1), 0, 0});
+    }
+
+    void check(Time t)
+    {
+        ++checked;
+        violations += enter(t);
+    }
+
+    // a send of an earlier run, taken into the windows but neither checked nor counted
+    void remember(Time t)               { enter(t); }
+
+    // check a send at t, entering it only if it keeps to every rule; false if it
+    // would break one, which counts as a violation
+    bool admit(Time t)
+    {
+        ++checked;
+        for (auto & w : windows) {
+            expire(w, t);
+            if (w.count == w.rule.max) {
+                ++violations;
+                return false;
+            }
+        }
+        enter(t);
+        return true;
+    }
+
+    std::size_t get_checked() const     { return checked;    }
+    std::size_t get_violations() const  { return violations; }
+
+private:
+
+    // drop the sends that have left the window by t
+    static void expire(Window & w, Time t)
+    {
+        while (w.count && w.ring[w.head] <= t - w.rule.len) {
+            w.head = (w.head + 1) % w.ring.size();
+            --w.count;
+        }
+    }
+
+    // true if the send at t broke a rule
+    bool enter(Time t)
+    {
+        bool violated = false;
+        for (auto & w : windows) {
+            const auto size = w.ring.size();
+            expire(w, t);
+            w.ring[(w.head + w.count) % size] = t;
+            if (++w.count > w.rule.max) {
+                violated = true;
+                w.head = (w.head + 1) % size;
+                --w.count;
+            }
+        }
+        return violated;
+    }
+};
+
+#endif
@@ -0,0 +1,293 @@
+// Asynchronous event log of the order system
+
+// [LogRecord] an event of an order (created, blocked, sent, or cancelled or amended
+//             while queued) as 32 bytes of plain data, so that logging it allocates
+//             nothing and takes no lock; or, in a journal, the beginning or the
+//             end of a run, or an order of a crashed run left in an unknown state.
+//             Files written before orders could be urgent decode the same.
+
+// [Logger] one lock-free single-producer ring (lane) per logging thread, emptied
+//          by a background thread (run) that formats the records into lines and
+//          writes them in batches, one write() per batch and per file, to the
+//          standard output (unless quiet) and, if given a path, the records as
+//          they are to a binary file. decode.cpp turns that file back into the
+//          same lines. Without a background thread, the owner of the lanes may
+//          drain() them itself, as the simulation does; a producer that finds its
+//          lane full then drains the lanes in place, on its own thread. As a
+//          journal, the binary file is appended to, and every batch written is made
+//          durable with one fdatasync() (a group commit) before the next is formed.
+
+// When a lane is full, the producer either blocks until the logger catches up, or
+// drops the record and counts it, as chosen by the Overflow policy.
+
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "queue.hpp"
+#include "wait.hpp"
+
+struct LogRecord
+{
+    enum Kind : std::int16_t { CREATED, BLOCKED, SENT, CANCELLED, AMENDED, BEGIN, END, UNKNOWN };
+
+    std::int16_t    kind;
+    std::int16_t    urgent;     // 1 if the order is urgent; was part of kind, always 0;
+                                // 1 if BEGIN of a simulation, in virtual time
+    std::int32_t    trader;
+    std::uint64_t   id;
+    std::int64_t    time;       // ns since begin, of the event; if BEGIN, ns since
+                                // 1970 (CLOCK_REALTIME) at begin
+    std::int64_t    until;      // ns since begin, the new time to send if BLOCKED;
+                                // quantity << 32 | price in ticks if AMENDED;
+                                // else the number of the venue, if there are several
+};
+
+static_assert(sizeof(LogRecord) == 32, "LogRecord is written as it is");
+
+// the line printed for a record, as snprintf; at most 128 characters
+inline int format(const LogRecord & r, char * out, std::size_t size)
+{
+    const auto id = static_cast<unsigned long long>(r.id);
+    const double t = r.time / 1e9;
+    switch (r.kind) {
+        case LogRecord::CREATED: {
+            const char * urgent = r.urgent ? ", urgent" : "";
+            if (r.until)
+                return std::snprintf(out, size, "Order # %llu\tcreated\tat time %.3f s by trader # %d"
+                                     " for venue # %lld%s\n", id, t, static_cast<int>(r.trader),
+                                     static_cast<long long>(r.until), urgent);
+            return std::snprintf(out, size, "Order # %llu\tcreated\tat time %.3f s by trader # %d%s\n",
+                                 id, t, static_cast<int>(r.trader), urgent);
+        }
+        case LogRecord::BLOCKED:
+            return std::snprintf(out, size, "Order # %llu\tblocked\tat time %.3f s to send at time %.3f s\n",
+                                 id, t, r.until / 1e9);
+        case LogRecord::SENT:
+            if (r.until)
+                return std::snprintf(out, size, "Order # %llu\tsent\tat time %.3f s to venue # %lld\n",
+                                     id, t, static_cast<long long>(r.until));
+            return std::snprintf(out, size, "Order # %llu\tsent\tat time %.3f s\n", id, t);
+        case LogRecord::CANCELLED:
+            return std::snprintf(out, size, "Order # %llu\tcancelled\tat time %.3f s by trader # %d\n",
+                                 id, t, static_cast<int>(r.trader));
+        case LogRecord::AMENDED:
+            return std::snprintf(out, size, "Order # %llu\tamended\tat time %.3f s to %lld at %.2f\n",
+                                 id, t, static_cast<long long>(r.until >> 32),
+                                 static_cast<std::uint32_t>(r.until) / 100.0);
+        case LogRecord::BEGIN:
+            return std::snprintf(out, size, "Run\tbegan at %lld ns since 1970%s\n",
+                                 static_cast<long long>(r.time), r.urgent ? ", simulated" : "");
+        case LogRecord::END:
+            return std::snprintf(out, size, "Run\tended at time %.3f s\n", t);
+        case LogRecord::UNKNOWN:
+            return std::snprintf(out, size, "Order # %llu\tunknown\tat time %.3f s, may have been sent"
+                                 " before a crash: not sent again\n", id, t);
+    }
+    return std::snprintf(out, size, "Order # %llu\tunknown event %d\n", id, static_cast<int>(r.kind));
+}
+
+// write all of a buffer, retrying on interruption; false on error
+inline bool write_all(int fd, const char * data, std::size_t size)
+{
+    while (size) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+enum class Overflow { BLOCK, DROP };
+
+class Logger
+{
+    struct alignas(CACHE_LINE) Lane
+    {
+        SpscRing<LogRecord>         ring;
+        std::atomic<std::size_t>    dropped{0};
+
+        explicit Lane(std::size_t capacity) : ring(capacity) {}
+    };
+
+    static constexpr std::size_t TEXT_BATCH   = 1 << 16;    // bytes
+    static constexpr std::size_t BINARY_BATCH = 1 << 11;    // records
+
+    std::vector<std::unique_ptr<Lane>> lanes;
+    const Overflow      overflow;
+    const bool          echo;           // write lines to the standard output
+    bool                in_place = false;   // no consumer thread: producers drain
+    std::unique_ptr<char[]>      text;  // batch of lines
+    std::unique_ptr<LogRecord[]> records;   // batch of records
+    std::size_t         t = 0, b = 0;   // sizes of the batches
+    Signal              signal;         // a lane pushed, or done
+    const int           out = STDOUT_FILENO;
+    int                 binary = -1;
+    const bool          journal;        // append to the binary file, and sync it
+    std::size_t         written = 0;    // records formatted
+    bool                failed = false; // a write to the binary file failed
+    std::size_t         commits = 0;    // batches made durable, if a journal
+    std::size_t         committed = 0;  // records in them
+    Time                committing = Time::zero();  // in write() and fdatasync()
+
+public:
+
+    // the producer side of one lane, for one thread
+    class Producer
+    {
+        Logger *    logger;
+        Lane *      lane;
+
+    public:
+
+        Producer(Logger * l, Lane * n) : logger(l), lane(n) {}
+
+        // false if the record was dropped
+        bool log(const LogRecord & r)
+        {
+            while (!lane->ring.try_push(r)) {
+                if (logger->in_place) {
+                    logger->drain();
+                    continue;
+                }
+                if (logger->overflow == Overflow::DROP) {
+                    lane->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+            logger->signal.notify();
+            return true;
+        }
+
+        // wake the consumer, e.g. after setting done
+        void wake()                     { logger->signal.notify(); }
+    };
+
+    // lanes for the given number of producers; a binary file too if path is not
+    // empty, appended to and synced if a journal
+    Logger(std::size_t producers, std::size_t capacity, Overflow policy, const std::string & path,
+           bool quiet = false, bool as_journal = false)
+        : overflow(policy), echo(!quiet),
+          text(new char[TEXT_BATCH]), records(new LogRecord[BINARY_BATCH]), journal(as_journal)
+    {
+        for (std::size_t i = 0; i != producers; ++i)
+            lanes.emplace_back(new Lane(capacity));
+        if (!path.empty()) {
+            binary = ::open(path.c_str(), O_WRONLY | O_CREAT | (journal ? O_APPEND : O_TRUNC), 0644);
+            failed = binary < 0;
+        }
+    }
+    Logger(const Logger &) = delete;
+    Logger & operator=(const Logger &) = delete;
+    ~Logger()
+    {
+        if (binary >= 0)
+            ::close(binary);
+    }
+
+    Producer producer(std::size_t i)    { return Producer(this, lanes[i].get()); }
+
+    // wake the consumer, e.g. after setting done
+    void wake()                         { signal.notify(); }
+
+    // the producers run on the thread that drains, one at a time: a full lane is
+    // drained at once, as nothing else would
+    void drain_in_place()               { in_place = true; }
+
+    // the consumer: drain all lanes in turn until done is set and they are empty;
+    // done is read before a pass so that a pass finding the lanes empty after it
+    // was set has seen everything
+    void run(const std::atomic<bool> & done, WaitStats & stats)
+    {
+        for (;;) {
+            auto seen = signal.prepare();
+            const bool finished = done.load();
+            const bool empty = !drain();
+            flush();
+            if (finished && empty)
+                break;
+            if (empty)
+                signal.wait(seen, INF, stats);
+        }
+    }
+
+    // one pass over all lanes, batching what is there; false if they were empty
+    bool drain()
+    {
+        bool any = false;
+        for (auto & lane : lanes) {
+            while (LogRecord * r = lane->ring.front()) {
+                if (TEXT_BATCH - t < 256 || b == BINARY_BATCH)
+                    flush();
+                if (echo)
+                    t += format(*r, text.get() + t, TEXT_BATCH - t);
+                records[b++] = *r;
+                lane->ring.pop();
+                ++written;
+                any = true;
+            }
+        }
+        return any;
+    }
+
+    // a record of the consumer's own, e.g. the BEGIN of a journal, written at once
+    // or with the next ones; not while run() or drain() may be running on another
+    // thread
+    void append(const LogRecord & r, bool at_once = true)
+    {
+        records[b++] = r;
+        if (at_once || b == BINARY_BATCH)
+            flush();
+    }
+
+    // write the batches; a journal's records are durable on return
+    void flush()
+    {
+        write_all(out, text.get(), t);
+        if (binary >= 0 && b) {
+            const Time start = monotonic_now();
+            if (!write_all(binary, reinterpret_cast<const char *>(records.get()), b * sizeof(LogRecord))
+                || (journal && ::fdatasync(binary) != 0))
+                failed = true;
+            else if (journal) {
+                ++commits;
+                committed += b;
+            }
+            committing += monotonic_now() - start;
+        }
+        t = b = 0;
+    }
+
+    std::size_t get_written() const     { return written; }
+    bool get_failed() const             { return failed;  }
+    bool is_journal() const             { return journal; }
+    std::size_t get_commits() const     { return commits;    }
+    std::size_t get_committed() const   { return committed;  }
+    Time get_committing() const         { return committing; }
+    std::size_t get_dropped() const
+    {
+        std::size_t n = 0;
+        for (const auto & lane : lanes)
+            n += lane->dropped.load(std::memory_order_relaxed);
+        return n;
+    }
+};
+
+#endif
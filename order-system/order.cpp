@@ -6,20 +6,95 @@
 
 // [COMPILE AND RUN]
 
-// To compile (on Windows): g++ order.cpp -fopenmp -std=c++14 
+// To compile (on Linux): g++ order.cpp -fopenmp -std=c++17 -O2
 
-// To run (on Windows):
+// To run (on Linux):
 
-// - default mode: a
+// - default mode: ./a.out
 
-// - factory mode: a f
+// - factory mode: ./a.out f
 
-// - file redirection, for example: a f < spec\one
+// - file redirection, for example: ./a.out f < spec/one
+
+// - options, in either mode:
+//   --orders=N  --traders=N  --max=N  --len=ms  --cycle=ms
+//                                             (the specifications, as in factory
+//                                              mode; ms may have a fraction)
+//   --batch=N                                 (send up to N orders in one pass,
+//                                              as many as the limits allow)
+//   --pace=BURST                              (space sends evenly at the rate of
+//                                              the limits, at most BURST back to
+//                                              back)
+//   --cycles=ms[,ms...]                       (cycles of the first traders, in
+//                                              place of --cycle)
+//   --fair  --weights=W[,W...]                (while the limits hold orders back,
+//                                              take turns across the traders, each
+//                                              sending up to its weight, 1 unless
+//                                              given, per turn)
+//   --urgent=SHARE  --aging=ms  --reserve=N   (share of orders created urgent, in
+//                                              [0, 1]; a normal order waiting so
+//                                              long is served as urgent; places of
+//                                              each window kept for urgent orders)
+//   --cancel=SHARE  --amend=SHARE             (share of cycles a trader cancels or
+//                                              amends one of its recent orders,
+//                                              if still queued)
+//   --clock=steady|tsc
+//   --limit=MAX/LEN                           (at most MAX orders in any LEN ms,
+//                                              on top of the limit of the spec;
+//                                              repeat for more limits)
+//   --venue=MAX/LEN[,MAX/LEN...]              (a venue with limits of its own, in
+//                                              place of the spec's; repeat for
+//                                              more venues, up to 16)
+//   --sent-capacity=N  --sent-file=path       (sent orders kept in memory, and
+//                                              the file older ones spill to)
+//   --sim  --seed=N                           (simulate in virtual time, as fast
+//                                              as possible; seed the traders)
+//   --quiet                                   (print neither events nor the log)
+//   --exchange=path                           (send the orders to an exchange at
+//                                              this Unix-domain socket, one
+//                                              connection per venue, see
+//                                              exchange.cpp)
+//   --guard=ms                                (keep to windows longer by so much,
+//                                              for the jitter on the way there)
+//   --json=path                               (export the latency percentiles)
+//   --log=path                                (also write the events to a binary
+//                                              file, see decode.cpp)
+//   --log-overflow=block|drop                 (when the logger falls behind)
+//   --journal=path                            (go on from the orders pending and
+//                                              the recent sends in this binary
+//                                              log, and append to it, synced in
+//                                              groups; in place of --log, and
+//                                              never dropping; after a crash, the
+//                                              windows are held full for their
+//                                              length, and the orders pending
+//                                              are not sent again; --orders
+//                                              counts the orders of all runs)
+//   --resend-unknown                          (after a crash, send the pending
+//                                              orders again, though some of them
+//                                              may have been sent already)
+//   --threads                                 (a dedicated thread for each role in
+//                                              place of an OpenMP team)
+//   --pin=ROLE:CPU[,CPU...]  --stack=ROLE:KB  (with dedicated threads: pin the
+//                                              threads of a role, trader, process
+//                                              or print, one to each CPU in turn;
+//                                              their stack size)
+//   --fifo=PRIORITY                           (with dedicated threads: run the
+//                                              processing threads SCHED_FIFO)
+//   --wait=spin|yield|futex|condvar           (both waiting threads)
+//   --wait-process=...  --wait-print=...      (one of them)
 
 #include "order.hpp"
 
-size_t Order::counter = 0;
-clock_t Order::begin = clock();
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <queue>
+#include <thread>
+
+static const SteadyClock steady_clock;
+
+const Clock * Order::clock = &steady_clock;
+Time Order::begin = steady_clock.now();
 
 void System::start(bool factory_mode)
 {
@@ -27,19 +102,64 @@ void System::start(bool factory_mode)
         await("start");
         Order::reset_time_begin();
     }
-    line("real time");
+    if (!p->is_quiet()) {                   // heads the log
+        line(p->is_simulation() ? "simulated time" : "real time");
+        cout << std::flush;                 // the logger writes to the descriptor directly
+    }
+    if (!p->get_journal().empty()) {
+        // the real time at begin, which the times of this run count from
+        const std::int64_t epoch = realtime_now()
+                                 - (p->is_simulation() ? 0 : Order::get_time_now().count());
+        recover(epoch);
+    }
+    if (p->is_simulation()) {
+        simulate();
+        return finish();
+    }
     const int NTR = p->get_num_traders();
-    # pragma omp parallel num_threads(NTR + 2)
-    {
-        int thread_id = omp_get_thread_num();
-        if (thread_id == 0)
-            print(to_print, process_done);
-        else if (thread_id == NTR + 1)
-            process(to_send, sent, to_print, traders_done, process_done);
-        else
-            generate(thread_id, to_send, to_print,
-                     orders_in_progress, orders_by_trader, traders_done);
+    const int NVN = static_cast<int>(venues.size());
+    // an OpenMP team, unless dedicated threads are asked for or the runtime would
+    // give the team fewer threads than roles
+    if (!p->uses_threads() && omp_get_thread_limit() >= NTR + NVN + 1) {
+        # pragma omp parallel num_threads(NTR + NVN + 1)
+        {
+            int thread_id = omp_get_thread_num();
+            if (thread_id == 0)
+                print(to_print, process_done);
+            else if (thread_id > NTR)
+                process(*venues[thread_id - NTR - 1], to_print.producer(thread_id - 1),
+                        traders_done, process_done);
+            else
+                generate(thread_id, to_print.producer(thread_id - 1), tickets, traders_done);
+        }
+        return finish();
+    }
+
+    // the same roles on dedicated threads, each placed as the spec says: the
+    // processing threads first, so that they wait before the traders push
+    vector<unique_ptr<Thread>> threads;
+    vector<string> names;
+    threads.emplace_back(new Thread([this] { print(to_print, process_done); },
+                                    p->get_placement(PRINTING), 0));
+    names.push_back("Print");
+    for (int v = 0; v != NVN; ++v) {
+        threads.emplace_back(new Thread([this, v, NTR] {
+            process(*venues[v], to_print.producer(NTR + v), traders_done, process_done);
+        }, p->get_placement(PROCESSING), v));
+        names.push_back(NVN > 1 ? "Venue # " + std::to_string(v + 1) : "Process");
+    }
+    for (int i = 1; i <= NTR; ++i) {
+        threads.emplace_back(new Thread([this, i] {
+            generate(i, to_print.producer(i - 1), tickets, traders_done);
+        }, p->get_placement(TRADING), i - 1));
+        names.push_back("Trader # " + std::to_string(i));
     }
+    for (size_t i = 0; i != threads.size(); ++i) {
+        threads[i]->join();
+        if (!threads[i]->get_error().empty())
+            placement_errors.push_back(names[i] + "\tnot placed as asked, " + threads[i]->get_error());
+    }
+    finish();
 }
 
 void System::report() const
@@ -47,31 +167,218 @@ void System::report() const
     await("show log");
     line("log");
 
-    for (const auto & order : sent)
-        cout << "Order # " << order.get_id()
-             << "\tcreated at time " << to_second(order.get_time_created())
-             << " by trader # " << order.get_creator()
-             << " to send at time " << to_second(order.get_time_to_send())
-             << " is sent at time " << to_second(order.get_time_sent()) << endl;
+    const auto NVN = venues.size();
+    if (!p->is_quiet())
+        for (size_t v = 0; v != NVN; ++v) {
+            const string at = NVN > 1 ? " at venue # " + std::to_string(v + 1) : "";
+            venues[v]->sent.for_each([&at](const SentRecord & order) {
+                cout << "Order # " << order.id
+                     << "\tcreated at time " << to_second(Time(order.time_created))
+                     << " by trader # " << order.creator
+                     << " to send at time " << to_second(Time(order.time_to_send))
+                     << " is sent at time " << to_second(Time(order.time_sent)) << at << '\n';
+            });
+        }
 
     await("show summary and specifications");
     line("summary");
     const auto NTR = p->get_num_traders();
+    vector<TraderStats> by_trader(NTR);
+    for (const auto & venue : venues)
+        for (int i = 0; i != NTR; ++i)
+            by_trader[i].merge(venue->by_trader[i]);
+    size_t at_limits = 0;
+    for (const auto & t : by_trader)
+        at_limits += t.at_limits;
     for (int i = 0; i != NTR; ++i) {
+        const auto & t = by_trader[i];
+        const size_t created = submit_stats[i].created;
         cout << "Trader # " << (i+1)
-             << "\tcreated " << orders_by_trader[i].size()
-             << " order" << (orders_by_trader[i].size() > 1 ? "s" : "")
-             << ": Order # ";
-        int n = 0;
-        for (auto id : orders_by_trader[i]) {
-            cout << id << " ";
-            if (++n > 10) {
-                cout << "...";
-                break;
-            }
+             << "\tcreated " << created
+             << " order" << (created > 1 ? "s" : "");
+        // fewer were sent if some were cancelled, more if some were recovered
+        if (t.orders != created)
+            cout << ", sent " << t.orders;
+        cout << ": Order # ";
+        for (size_t n = 0; n != std::min(t.orders, TraderStats::SHOWN); ++n)
+            cout << t.ids[n] << " ";
+        if (t.orders > TraderStats::SHOWN)
+            cout << "...";
+        if (t.orders)
+            cout << "\twaited mean " << to_second(t.wait_total / t.orders)
+                 << ", max " << to_second(t.wait.get_max());
+        if (at_limits)
+            cout << "\tsent " << fixed << setprecision(1) << 100.0 * t.at_limits / at_limits
+                 << "% of orders at the limits, " << t.orders / (get_last_sent().count() / 1e9)
+                 << " a second in all";
+        cout << endl;
+    }
+    if (!pending.empty()) {
+        size_t cancels = 0, cancelled = 0, amends = 0, amended = 0;
+        for (const auto & s : submit_stats) {
+            cancels += s.cancels;
+            cancelled += s.cancelled;
+            amends += s.amends;
+            amended += s.amended;
         }
+        cout << "Cancelled " << cancelled << " of " << cancels << " orders tried while queued, amended "
+             << amended << " of " << amends << " (the others were sent already)" << endl;
+        const auto limits = p->get_venues();
+        for (size_t v = 0; v != NVN; ++v) {
+            const auto & venue = *venues[v];
+            if (!venue.cancelled)
+                continue;
+            // the time the places saved take at the binding rule, sending at its rate
+            Time saved = Time::zero();
+            for (const auto & rule : limits[v])
+                saved = std::max(saved, rule.len * static_cast<Time::rep>(venue.cancelled)
+                                        / static_cast<Time::rep>(rule.max));
+            cout << (NVN > 1 ? "Venue # " + std::to_string(v + 1) + "\t" : "") << "Saved "
+                 << venue.cancelled << " places of the windows ("
+                 << fixed << setprecision(1)
+                 << 100.0 * venue.cancelled / (venue.audit.get_checked() + venue.cancelled)
+                 << "% of its orders), " << to_second(saved) << " of sending at the limits" << endl;
+        }
+    }
+#ifdef ORDER_COUNT_ALLOCATIONS
+    cout << "Heap allocations from creating to sending orders: "
+         << order_path_allocations.load() << endl;
+#endif
+    if (to_print.get_dropped())
+        cout << "Dropped " << to_print.get_dropped() << " log records, the logger fell behind" << endl;
+    if (to_print.get_failed())
+        cout << "Failed to write the binary log "
+             << (to_print.is_journal() ? p->get_journal() : p->get_log_file()) << endl;
+    if (!recovery.error.empty())
+        cout << "Failed to read the journal " << p->get_journal() << ", " << recovery.error << endl;
+    if (to_print.is_journal()) {
+        const auto commits = std::max<size_t>(to_print.get_commits(), 1);
+        const double busy = std::max(to_print.get_committing().count(), Time::rep(1)) / 1e9;
+        cout << "Journal\tcommitted " << to_print.get_committed() << " records in "
+             << to_print.get_commits() << " groups, " << fixed << setprecision(1)
+             << 1.0 * to_print.get_committed() / commits << " a group, "
+             << to_print.get_committing().count() / 1e3 / commits
+             << " us to write and sync one: " << setprecision(0) << to_print.get_committed() / busy
+             << " records/s" << endl;
+        cout << "Recovered\t" << recovery.events << " events of " << recovery.runs << " run"
+             << (recovery.runs != 1 ? "s" : "") << " (" << setprecision(1) << recovery.bytes / 1e6
+             << " MB) in " << to_second(recovery.took) << ": queued " << requeued
+             << " pending orders again, " << remembered << " sends the limits still count";
+        if (unqueued)
+            cout << ", " << unqueued << " left pending, their queues were full";
+        if (unknown)
+            cout << ", " << unknown << " in an unknown state, not sent again (see --resend-unknown)";
+        if (recovery.cut && !p->is_simulation())
+            cout << "; the last run crashed, so every window was held full at restart";
         cout << endl;
     }
+    for (const auto & venue : venues) {
+        const auto & sent = venue->sent;
+        if (sent.get_spilled())
+            cout << "Spilled " << sent.get_spilled() << " records of sent orders to "
+                 << sent.get_path() << (sent.get_lost() ? ", failed to write " : "")
+                 << (sent.get_lost() ? std::to_string(sent.get_lost()) : "") << endl;
+    }
+
+    auto sent_line = [](const string & who, size_t sent, size_t violations) {
+        cout << who << "ent " << sent << " order" << (sent != 1 ? "s" : "")
+             << ", violating a limit " << violations << " time" << (violations != 1 ? "s" : "") << endl;
+    };
+    size_t violations = 0;
+    for (size_t v = 0; v != NVN; ++v) {
+        const auto & audit = venues[v]->audit;
+        violations += audit.get_violations();
+        if (NVN > 1)
+            sent_line("Venue # " + std::to_string(v + 1) + "\ts", audit.get_checked(), audit.get_violations());
+    }
+    sent_line(NVN > 1 ? "In all s" : "S", get_sent(), violations);
+    for (size_t v = 0; v != NVN; ++v)
+        if (const auto & t = venues[v]->transport)
+            cout << (NVN > 1 ? "Venue # " + std::to_string(v + 1) + " exchange" : "Exchange")
+                 << "\tsent " << t->get_sent() << " of them, acked " << t->get_acked()
+                 << ", rejected " << t->get_rejected() << endl;
+    if (p->get_batch() > 1)
+        for (size_t v = 0; v != NVN; ++v) {
+            const auto & b = venues[v]->batches;
+            cout << (NVN > 1 ? "Venue # " + std::to_string(v + 1) + "\ts" : "S") << "ent in "
+                 << b.count() << " passes of up to " << p->get_batch() << " orders: median "
+                 << b.percentile(0.5).count() << ", max " << b.get_max().count() << endl;
+        }
+    if (p->is_simulation()) {
+        const double wall = std::max(simulation_wall.count(), Time::rep(1)) / 1e9;
+        cout << "Simulated " << to_second(simulated) << " in " << to_second(simulation_wall)
+             << " (seed " << p->get_seed() << "): " << fixed << setprecision(0)
+             << get_sent() / wall << " orders/s, "
+             << simulated.count() / 1e9 / wall << " times real time" << endl;
+    }
+
+    line("latency (us)");
+    cout << std::left << std::setw(24) << "" << std::right << std::setw(10) << "count";
+    for (auto name : PERCENTILE_NAMES)
+        cout << std::setw(16) << name;
+    cout << std::setw(16) << "max" << endl;
+    auto row = [](const string & name, const Histogram & h) {
+        cout << std::left << std::setw(24) << name << std::right << std::setw(10) << h.count()
+             << fixed << setprecision(1);
+        for (double q : PERCENTILES)
+            cout << std::setw(16) << h.percentile(q).count() / 1e3;
+        cout << std::setw(16) << h.get_max().count() / 1e3 << endl;
+    };
+    Histogram wait, throttle, submit;
+    for (int i = 0; i != NTR; ++i) {
+        const string trader = "Trader # " + std::to_string(i + 1);
+        row(trader + " wait", by_trader[i].wait);
+        row(trader + " throttle", by_trader[i].throttle);
+        row(trader + " submit", submit_stats[i].submit);
+        wait.merge(by_trader[i].wait);
+        throttle.merge(by_trader[i].throttle);
+        submit.merge(submit_stats[i].submit);
+    }
+    row("All wait", wait);
+    if (p->get_urgent_share() > 0) {
+        Histogram lanes[PRIORITIES];
+        for (const auto & venue : venues)
+            for (int i = 0; i != PRIORITIES; ++i)
+                lanes[i].merge(venue->waits[i]);
+        row("Urgent wait", lanes[URGENT]);
+        row("Normal wait", lanes[NORMAL]);
+    }
+    row("All throttle", throttle);
+    row("All submit", submit);
+    for (size_t v = 0; v != NVN; ++v) {
+        const string venue = NVN > 1 ? "Venue # " + std::to_string(v + 1) + " " : "";
+        row(venue + (NVN > 1 ? "dispatch" : "Dispatch"), venues[v]->dispatching);
+        row(venue + (NVN > 1 ? "drain" : "Drain"), venues[v]->draining);
+        row(venue + (NVN > 1 ? "gap" : "Gap"), venues[v]->gaps);
+        if (venues[v]->transport)
+            row(venue + (NVN > 1 ? "round trip" : "Round trip"), venues[v]->transport->get_round_trip());
+    }
+    if (!p->get_json_file().empty())
+        export_json(p->get_json_file());
+
+    line("threads");
+    auto show = [](const char * role, const WaitStats & w) {
+        auto wall = std::max(w.wall.count(), Time::rep(1));
+        cout << role << "\twait " << to_string(w.strategy)
+             << "\tCPU " << to_second(w.cpu)
+             << " (" << fixed << setprecision(1) << 100.0 * w.cpu.count() / wall << "%)"
+             << "\twaits " << w.waits << ", parked " << w.parks
+             << "\twake-up latency mean "
+             << setprecision(1) << (w.wakes ? w.wake_total.count() / 1e3 / w.wakes : 0.0)
+             << " us, p99 " << w.wake.percentile(0.99).count() / 1e3
+             << " us, max " << w.wake_max.count() / 1e3 << " us" << endl;
+    };
+    for (size_t v = 0; v != NVN; ++v)
+        show(NVN > 1 ? ("Venue # " + std::to_string(v + 1)).c_str() : "Process",
+             venues[v]->process_stats);
+    show("Print  ", print_stats);
+    if (p->uses_threads()) {
+        cout << "Dedicated threads\ttraders " << to_string(p->get_placement(TRADING))
+             << "; processing " << to_string(p->get_placement(PROCESSING))
+             << "; print " << to_string(p->get_placement(PRINTING)) << endl;
+        for (const auto & error : placement_errors)
+            cout << error << endl;
+    }
 
     line("specifications");
     const auto NOD = p->get_num_orders_to_gen();
@@ -82,147 +389,730 @@ void System::report() const
     cout << "Number of traders\t" << NTR << endl;
     cout << "Length of interval\t" << to_second(LEN) << endl;
     cout << "Max orders in interval\t" << MAX << endl;
+    for (const auto & rule : p->get_rules())
+        if (rule.len != LEN || rule.max != MAX)
+            cout << "Further limit\t\t" << rule.max << " in " << to_second(rule.len) << endl;
+    if (NVN > 1) {
+        const auto limits = p->get_venues();
+        for (size_t v = 0; v != NVN; ++v) {
+            cout << "Venue # " << (v + 1) << " limits\t";
+            for (const auto & rule : limits[v])
+                cout << (&rule != &limits[v][0] ? ", " : "") << rule.max << " in " << to_second(rule.len);
+            cout << endl;
+        }
+    }
     cout << "Order generation cycle\t" << to_second(CYC) << endl;
+    for (int i = 1; i <= NTR; ++i)
+        if (p->get_order_cycle(i) != CYC)
+            cout << "Cycle of trader # " << i << "\t" << to_second(p->get_order_cycle(i)) << endl;
+    if (p->is_fair()) {
+        cout << "Fair, weights\t\t";
+        for (const auto w : p->get_weights())
+            cout << w << " ";
+        cout << endl;
+    }
+    if (p->get_pace_burst())
+        cout << "Paced, burst of\t\t" << p->get_pace_burst() << endl;
+    if (!p->get_journal().empty())
+        cout << "Journal\t\t\t" << p->get_journal() << endl;
+    if (!p->get_exchange().empty())
+        cout << "Exchange\t\t" << p->get_exchange() << ", guard "
+             << fixed << setprecision(3) << p->get_guard().count() / 1e6 << " ms" << endl;
+    if (!pending.empty())
+        cout << "Cancels, amends\t\t" << p->get_cancel_share() * 100 << "%, "
+             << p->get_amend_share() * 100 << "% of cycles" << endl;
+    if (p->get_urgent_share() > 0)
+        cout << "Urgent orders\t\t" << p->get_urgent_share() * 100 << "%, aging "
+             << (p->get_aging() > Time::zero() ? to_second(p->get_aging()) : "never")
+             << ", reserved " << p->get_reserve() << " of each window" << endl;
 }
 
-void System::generate(int               trader_id,
-                      deque<Order> &    to_send,
-                      deque<string> &   to_print,
-                      int &             orders_in_progress,
-                      set<size_t> *     orders_by_trader,
-                      int &             traders_done)
+// the latency histograms and the outcome of the run, for comparing runs
+void System::export_json(const string & path) const
 {
-    const auto NOD = p->get_num_orders_to_gen();
-    const auto CYC = p->get_order_cycle();
+    std::ofstream os(path);
+    export_json(os);
+    if (!os)
+        cout << "Failed to write " << path << endl;
+}
+
+void System::export_json(std::ostream & os) const
+{
+    const auto NTR = p->get_num_traders();
+    os << "{\n  \"spec\": {\"orders\": " << p->get_num_orders_to_gen()
+       << ", \"traders\": " << NTR
+       << ", \"cycle_ns\": " << p->get_order_cycle().count()
+       << ", \"batch\": " << p->get_batch()
+       << ", \"urgent\": " << p->get_urgent_share()
+       << ", \"aging_ns\": " << p->get_aging().count()
+       << ", \"reserve\": " << p->get_reserve()
+       << ", \"pace_burst\": " << p->get_pace_burst()
+       << ", \"guard_ns\": " << p->get_guard().count()
+       << ", \"fair\": " << (p->is_fair() ? "true" : "false")
+       << ", \"cancel\": " << p->get_cancel_share()
+       << ", \"amend\": " << p->get_amend_share()
+       << ", \"clock\": \"" << p->get_clock()
+       << "\", \"wait_process\": \"" << to_string(p->get_process_wait())
+       << "\", \"wait_print\": \"" << to_string(p->get_print_wait())
+       << "\", \"threads\": \"" << (p->uses_threads() ? "dedicated" : "openmp")
+       << "\", \"placement\": {\"trader\": \"" << to_string(p->get_placement(TRADING))
+       << "\", \"process\": \"" << to_string(p->get_placement(PROCESSING))
+       << "\", \"print\": \"" << to_string(p->get_placement(PRINTING)) << "\"}, \"limits\": ";
+    auto limits = [&os](const vector<Rule> & rules) {
+        os << "[";
+        for (size_t i = 0; i != rules.size(); ++i)
+            os << (i ? ", " : "") << "{\"max\": " << rules[i].max << ", \"len_ns\": " << rules[i].len.count() << "}";
+        os << "]";
+    };
+    limits(p->get_rules());
+    size_t violations = 0;
+    for (const auto & venue : venues)
+        violations += venue->audit.get_violations();
+    os << "},\n  \"sent\": " << get_sent()
+       << ",\n  \"orders_per_s\": " << get_throughput()
+       << ",\n  \"violations\": " << violations
+       << ",\n  \"dropped_log_records\": " << to_print.get_dropped();
+    if (to_print.is_journal())
+        os << ",\n  \"journal\": {\"committed\": " << to_print.get_committed()
+           << ", \"commits\": " << to_print.get_commits()
+           << ", \"commit_ns\": " << to_print.get_committing().count()
+           << ", \"recovered_events\": " << recovery.events
+           << ", \"recovery_ns\": " << recovery.took.count()
+           << ", \"requeued\": " << requeued
+           << ", \"unknown\": " << unknown
+           << ", \"remembered_sends\": " << remembered
+           << ", \"held_full\": " << (recovery.cut && !p->is_simulation() ? "true" : "false") << "}";
+    os
+       << ",\n  \"latency_ns\": {\n    \"dispatch\": ";
+    to_json(os, get_dispatch_latency());
+    vector<TraderStats> by_trader(NTR);
+    for (const auto & venue : venues)
+        for (int i = 0; i != NTR; ++i)
+            by_trader[i].merge(venue->by_trader[i]);
+    Histogram wait, throttle, submit;
+    os << ",\n    \"traders\": [";
+    for (int i = 0; i != NTR; ++i) {
+        os << (i ? "," : "") << "\n      {\"trader\": " << (i + 1)
+           << ", \"cycle_ns\": " << p->get_order_cycle(i + 1).count()
+           << ", \"created\": " << submit_stats[i].created
+           << ", \"sent\": " << by_trader[i].orders << ", \"sent_at_limits\": " << by_trader[i].at_limits
+           << ", \"wait\": ";
+        to_json(os, by_trader[i].wait);
+        os << ", \"throttle\": ";
+        to_json(os, by_trader[i].throttle);
+        os << ", \"submit\": ";
+        to_json(os, submit_stats[i].submit);
+        os << "}";
+        wait.merge(by_trader[i].wait);
+        throttle.merge(by_trader[i].throttle);
+        submit.merge(submit_stats[i].submit);
+    }
+    os << "\n    ],\n    \"all\": {\"wait\": ";
+    to_json(os, wait);
+    os << ", \"throttle\": ";
+    to_json(os, throttle);
+    os << ", \"submit\": ";
+    to_json(os, submit);
+    Histogram lanes[PRIORITIES];
+    for (const auto & venue : venues)
+        for (int i = 0; i != PRIORITIES; ++i)
+            lanes[i].merge(venue->waits[i]);
+    os << "},\n    \"lanes\": {\"urgent\": ";
+    to_json(os, lanes[URGENT]);
+    os << ", \"normal\": ";
+    to_json(os, lanes[NORMAL]);
+    os << "}\n  },\n  \"venues\": [";
+    const auto venue_limits = p->get_venues();
+    for (size_t v = 0; v != venues.size(); ++v) {
+        const auto & venue = *venues[v];
+        os << (v ? "," : "") << "\n    {\"venue\": " << (v + 1) << ", \"limits\": ";
+        limits(venue_limits[v]);
+        os << ", \"sent\": " << venue.audit.get_checked()
+           << ", \"cancelled\": " << venue.cancelled
+           << ", \"violations\": " << venue.audit.get_violations() << ", \"dispatch_ns\": ";
+        to_json(os, venue.dispatching);
+        os << ", \"drain_ns\": ";
+        to_json(os, venue.draining);
+        os << ", \"gap_ns\": ";
+        to_json(os, venue.gaps);
+        os << ", \"wake_ns\": ";
+        to_json(os, venue.process_stats.wake);
+        if (venue.transport) {
+            os << ",\n     \"exchange\": {\"sent\": " << venue.transport->get_sent()
+               << ", \"acked\": " << venue.transport->get_acked()
+               << ", \"rejected\": " << venue.transport->get_rejected() << ", \"round_trip_ns\": ";
+            to_json(os, venue.transport->get_round_trip());
+            os << "}";
+        }
+        os << ",\n     \"batch\": ";
+        to_json(os, venue.batches);
+        os << ",\n     \"queue_depth\": ";
+        to_json(os, venue.depth);
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
 
-    default_random_engine e(0);
+// run the traders and the processing threads as events in virtual time on this
+// thread: a trader steps every cycle, the processing thread of a venue whenever it
+// has an order it may send. Events at the same time run in a fixed order
+// (processing by venue, then traders by id), so a run depends only on the spec and
+// the seed.
+void System::simulate()
+{
+    using Event = std::pair<Time, int>;     // when, which trader
+    auto & virtual_clock = static_cast<VirtualClock &>(*clock);
+    const int NTR = p->get_num_traders();
+    const size_t NVN = venues.size();
+    auto cycle = [this](int trader) {                           // time must move on
+        return std::max(p->get_order_cycle(trader), Time(1));
+    };
+    const Time wall = monotonic_now();
+
+    std::priority_queue<Event, vector<Event>, std::greater<Event>> traders;
+    vector<default_random_engine> engines;
+    vector<Logger::Producer> loggers;
+    for (int i = 1; i <= NTR; ++i) {
+        traders.push(Event(Time::zero(), i));
+        engines.emplace_back(p->get_seed() + i);
+        loggers.push_back(to_print.producer(i - 1));
+    }
+    vector<Logger::Producer> dispatchers;
+    for (size_t v = 0; v != NVN; ++v)
+        dispatchers.push_back(to_print.producer(NTR + v));
+    vector<Time> dispatch_at(NVN, INF);    // of each venue
+    size_t hot = 0;
+    size_t events = 0;
+    // an event logs at most a record per order of a pass and one of a block, or
+    // those of creating and revising an order; drain before a lane can fill up,
+    // and after every event for the lines to come out in the order of the events
+    const size_t per_event = std::max<size_t>(p->get_batch() + 1, 2);
+    const size_t drain_every = p->is_quiet() ? std::max<size_t>(p->get_print_capacity() / per_event, 1) : 1;
+    // a pass larger than a lane fills it anyway
+    to_print.drain_in_place();
+
+    for (;;) {
+        const size_t v = std::min_element(dispatch_at.begin(), dispatch_at.end()) - dispatch_at.begin();
+        if (traders.empty() && dispatch_at[v] == INF)
+            break;
+        if (dispatch_at[v] != INF && (traders.empty() || dispatch_at[v] <= traders.top().first)) {
+            virtual_clock.advance_to(Order::get_time_begin() + dispatch_at[v]);
+            dispatch_at[v] = dispatch_step(*venues[v], dispatchers[v]);
+        }
+        else {
+            const auto event = traders.top();
+            traders.pop();
+            virtual_clock.advance_to(Order::get_time_begin() + event.first);
+            const int i = event.second;
+            int pushed;
+            if (trader_step(i, engines[i - 1], loggers[i - 1], tickets, hot, pushed))
+                traders.push(Event(event.first + cycle(i), i));
+            else
+                traders_done.fetch_add(1);
+            // a new order may be the next to send, unless one is blocked and the
+            // new one cannot be urgent
+            if (pushed >= 0 && (dispatch_at[pushed] == INF || p->get_urgent_share() > 0))
+                dispatch_at[pushed] = std::min(dispatch_at[pushed], event.first);
+        }
+        if (++events == drain_every) {
+            to_print.drain();
+            events = 0;
+        }
+    }
+    for (const auto & venue : venues)
+        hot += venue->dispatch_allocations;
+    order_path_allocations.fetch_add(hot);
+    process_done.store(true);
+    to_print.drain();
+    to_print.flush();
+    simulated = Order::get_time_now();
+    simulation_wall = monotonic_now() - wall;
+}
+
+// one cycle of a trader: maybe create an order, route it to a venue and schedule
+// it there (pushed is the venue, or -1); false once all the orders to generate
+// have been created
+bool System::trader_step(int                    trader_id,
+                         default_random_engine & e,
+                         Logger::Producer &     to_print,
+                         atomic<size_t> &       tickets,
+                         size_t &               hot,
+                         int &                  pushed)
+{
+    const auto NOD = p->get_num_orders_to_gen();
+    const int NVN = static_cast<int>(venues.size());
     bernoulli_distribution b(0.5);
+    pushed = -1;
 
-    while (Order::get_orders_created() < NOD) {
-        bool permit_to_create = false;
-        # pragma omp critical (planning)
-        {
-            // if: (orders created) + (orders in progress) < (orders to generate)
-            //    then: permit to create
-            if (Order::get_orders_created() + orders_in_progress < NOD) {
-                permit_to_create = true;
-                orders_in_progress += 1;
-            }
+    // random generate, to a random venue, maybe urgent (what is not in use is not
+    // drawn, so that runs are as they were); a trader whose queue is full holds back
+    const bool create = b(e);
+    const int v = create && NVN > 1 ? std::uniform_int_distribution<int>(0, NVN - 1)(e) : 0;
+    const Priority priority = create && p->get_urgent_share() > 0
+                            && bernoulli_distribution(p->get_urgent_share())(e) ? URGENT : NORMAL;
+    Fifo & lane = venues[v]->lanes[priority];
+    if (create && lane.to_send[trader_id - 1]->size() < p->get_queue_capacity()) {
+        Venue & venue = *venues[v];
+        const size_t before = allocations;
+        const Time start = monotonic_now();
+        // take a ticket: the id of the order, if (orders created) < (orders to generate)
+        const size_t id = tickets.fetch_add(1) + 1;
+        if (id > NOD)
+            return false;
+        // and a place in the FIFO of its lane at the venue; with one venue, no
+        // urgent orders and no orders recovered ahead of it, the id is the place
+        const size_t seq = NVN > 1 || p->get_urgent_share() > 0 || !p->get_journal().empty()
+                         ? lane.tickets.fetch_add(1) + 1 : id;
+        Order order(id, trader_id, v, priority, seq);
+
+        // print
+        to_print.log(LogRecord{LogRecord::CREATED, priority == URGENT, order.get_creator(),
+                               order.get_id(), order.get_time_created().count(), venue_field(v)});
+
+        // enqueue: schedule to send (never fails, this is the only producer)
+        lane.to_send[trader_id - 1]->try_push(std::move(order));
+        if (!pending.empty())
+            pending[trader_id - 1]->insert(id, lane.to_send[trader_id - 1]->back());
+        venue.sending.notify();
+        if (priority == URGENT)
+            venue.urgent.notify();
+        pushed = v;
+        hot += allocations - before;
+
+        submit_stats[trader_id - 1].submit.record(monotonic_now() - start);
+        ++submit_stats[trader_id - 1].created;
+    }
+    if (!pending.empty())
+        revise(trader_id, e, to_print);
+    return tickets.load(std::memory_order_relaxed) < NOD;
+}
+
+// maybe cancel or amend one of the orders the trader created lately, found by id;
+// it takes effect only if the order is still queued, and a cancelled order never
+// takes a place of the windows
+void System::revise(int trader_id, default_random_engine & e, Logger::Producer & to_print)
+{
+    auto & index = *pending[trader_id - 1];
+    auto & stats = submit_stats[trader_id - 1];
+    bernoulli_distribution cancel(p->get_cancel_share()), amend(p->get_amend_share());
+    const bool cancelling = p->get_cancel_share() > 0 && cancel(e);
+    const bool amending = !cancelling && p->get_amend_share() > 0 && amend(e);
+    if (!index.size() || !(cancelling || amending))
+        return;
+    const auto id = index.recent(std::uniform_int_distribution<size_t>(0, index.size() - 1)(e));
+    Order * order = index.find(id);
+    // the slot may have been reused since
+    if (order && order->get_id() != id)
+        order = nullptr;
+    const Time now = Order::get_time_now();
+    if (cancelling) {
+        ++stats.cancels;
+        if (order && order->cancel()) {
+            ++stats.cancelled;
+            to_print.log(LogRecord{LogRecord::CANCELLED, order->get_priority() == URGENT, trader_id,
+                                   id, now.count(), 0});
         }
-        if (permit_to_create) {
-            // random generate
-            if (b(e)) {
-                Order order(trader_id);
-                orders_by_trader[trader_id - 1].insert(order.get_id());
-
-                // print
-                ostringstream oss;
-                oss << "Order # " << order.get_id() << "\tcreated\tat time "
-                    << to_second(order.get_time_created()) 
-                    << " by trader # " << order.get_creator() << endl;
-                # pragma omp critical (printing)
-                {
-                    to_print.push_back(oss.str());
-                }
-
-                // enqueue: schedule to send
-                # pragma omp critical (sending)
-                {
-                    to_send.push_back(std::move(order));
-                }
-            }
-            # pragma omp critical (planning)
-            {
-                orders_in_progress -= 1;
-            }
+    }
+    else {
+        ++stats.amends;
+        const std::int64_t quantity = 100 * std::uniform_int_distribution<int>(1, 10)(e);
+        const std::int64_t price = 10000 + std::uniform_int_distribution<int>(-100, 100)(e);
+        if (order && order->claim()) {
+            order->amend(quantity, price);
+            const bool urgent = order->get_priority() == URGENT;
+            order->release();
+            ++stats.amended;
+            to_print.log(LogRecord{LogRecord::AMENDED, urgent, trader_id, id, now.count(),
+                                   quantity << 32 | price});
         }
-        Sleep(CYC);
     }
+}
+
+void System::generate(int                   trader_id,
+                      Logger::Producer      to_print,
+                      atomic<size_t> &      tickets,
+                      atomic<int> &         traders_done)
+{
+    const auto CYC = p->get_order_cycle(trader_id);
 
-    # pragma omp critical (finishing)
-    {
-        traders_done += 1;
+    default_random_engine e(p->get_seed() + trader_id);
+    size_t hot = 0;                         // allocations on the order path
+    int pushed;
+
+    while (trader_step(trader_id, e, to_print, tickets, hot, pushed))
+        Order::sleep_for(CYC);
+
+    order_path_allocations.fetch_add(hot);
+    traders_done.fetch_add(1);
+    for (const auto & venue : venues)
+        venue->sending.notify();
+}
+
+// one step of the processing thread of a venue: send its next orders, as many as
+// the limits let go at once and at most a batch; returns when to step again: now
+// after sending, the time to send of a blocked order, or INF if the next order is
+// not in a queue yet
+Time System::dispatch_step(Venue & venue, Logger::Producer & to_print)
+{
+    const Time start = monotonic_now();
+    const Time now = Order::get_time_now();
+    if (venue.depth.due(now))
+        venue.depth.record(now, static_cast<std::int64_t>(venue.size()));
+    Fifo * lane;
+    size_t reserve;
+    Order * order = next(venue, now, lane, reserve);
+    if (!order) {
+        // the backlog left by a throttle is sent
+        if (venue.drain_from != INF) {
+            venue.draining.record(now - venue.drain_from);
+            venue.drain_from = INF;
+        }
+        return INF;
     }
+
+    if (!let_go(venue, *order, reserve)) {
+        venue.throttled = true;
+        // print, once per new time to send
+        if (order->get_time_to_send() != venue.blocked_until) {
+            venue.blocked_until = order->get_time_to_send();
+            to_print.log(LogRecord{LogRecord::BLOCKED, order->get_priority() == URGENT,
+                                   order->get_creator(), order->get_id(),
+                                   Order::get_time_now().count(), venue.blocked_until.count()});
+        }
+        // kept out of the reserve, it may use it once aged
+        if (reserve && p->get_aging() > Time::zero())
+            return std::min(order->get_time_to_send(), order->get_time_created() + p->get_aging());
+        return order->get_time_to_send();
+    }
+
+    // the trader may be amending it, or have just cancelled it
+    if (!order->claim())
+        return now;
+
+    const size_t before = allocations;
+    // stamp the batch with one time sent; the limits allow the first
+    const Time time_sent = Order::get_time_now();
+    if (venue.throttled && venue.drain_from == INF)
+        venue.drain_from = time_sent;
+    venue.throttled = false;
+    const std::int64_t wire_time = venue.transport ? monotonic_now().count() : 0;
+    size_t n = 0, out = 0;
+    do {
+        order->set_time_sent(time_sent);
+        order->set_sent();
+        venue.limiter.record(time_sent);
+        venue.pacer.record(time_sent);
+        venue.audit.check(time_sent);
+        // record: has been sent
+        const SentRecord record{order->get_id(),
+                                order->get_creator(),
+                                order->get_time_created().count(),
+                                order->get_time_to_send().count(),
+                                order->get_time_sent().count()};
+        const auto field = venue_field(order->get_venue());
+        const Priority priority = order->get_priority();
+        venue.sent.push(record);
+        venue.by_trader[record.creator - 1].add(record);
+        if (venue.drain_from != INF)
+            ++venue.by_trader[record.creator - 1].at_limits;
+        venue.waits[priority].record(Time(record.time_sent - record.time_created));
+        // to the exchange, built in place, a full outbox at a time
+        if (venue.transport) {
+            venue.outbox[out++] = WireOrder{WireOrder::ORDER,
+                                            static_cast<std::uint16_t>(order->get_venue() + 1),
+                                            static_cast<std::int32_t>(record.creator), record.id,
+                                            static_cast<std::int32_t>(order->get_quantity()),
+                                            static_cast<std::int32_t>(order->get_price()), wire_time};
+            if (out == venue.outbox.size()) {
+                venue.transport->send(venue.outbox.data(), out);
+                out = 0;
+            }
+        }
+        // dequeue from schedule
+        lane->pop(true);
+
+        // print
+        to_print.log(LogRecord{LogRecord::SENT, priority == URGENT, static_cast<int>(record.creator),
+                               record.id, record.time_sent, field});
+        ++n;
+    } while (n != p->get_batch() && (order = next(venue, time_sent, lane, reserve))
+             && venue.limiter.allowance(time_sent, 1, reserve) && venue.pacer.allowance(time_sent, 1)
+             && order->claim());
+    if (out)
+        venue.transport->send(venue.outbox.data(), out);
+    venue.dispatch_allocations += allocations - before;
+    venue.dispatching.record(monotonic_now() - start);
+    venue.batches.record(Time(static_cast<Time::rep>(n)));
+    if (venue.audit.get_checked() > n)
+        venue.gaps.record(time_sent - venue.last_sent);
+    venue.last_sent = time_sent;
+    return venue.last_sent;
 }
 
-void System::process(deque<Order> &     to_send,
-                     deque<Order> &     sent,
-                     deque<string> &    to_print,
-                     const int &        traders_done,
-                     bool &             process_done)
+void System::process(Venue &              venue,
+                     Logger::Producer     to_print,
+                     const atomic<int> &  traders_done,
+                     atomic<bool> &       process_done)
 {
+    const Time wall = Order::get_time_now();
     int NTR = p->get_num_traders();
-    while (!(traders_done == NTR && to_send.empty())) {
-        # pragma omp critical (sending)
-        {
-            if (!to_send.empty()) {
-                Order & order = to_send.front();
-                if (let_go(order, sent)) {
-                    // enqueue: has been sent
-                    sent.push_back(std::move(order));
-                    // stamp with time sent
-                    sent.back().set_time_sent(Order::get_time_now());
-                    // dequeue from schedule
-                    to_send.pop_front();
-
-                    // print
-                    ostringstream oss;
-                    oss << "Order # " << sent.back().get_id()
-                        << "\tsent\tat time "
-                        << to_second(sent.back().get_time_sent())
-                        << endl;
-                    # pragma omp critical (printing)
-                    {
-                        to_print.push_back(oss.str());
-                    }
-                }
-            }
+    const bool urgent_lane = p->get_urgent_share() > 0;
+    auto empty = [](const Fifo & lane) {
+        return std::all_of(lane.to_send.begin(), lane.to_send.end(),
+                           [](const unique_ptr<SpscRing<Order>> & q) { return q->empty(); });
+    };
+    for (;;) {
+        auto seen = venue.sending.prepare();
+        auto seen_urgent = venue.urgent.prepare();
+        // the traders are done before their queues are read to be empty
+        const bool done = traders_done.load() == NTR;
+        const Time t = dispatch_step(venue, to_print);
+        if (t == INF) {
+            if (done && empty(venue.lanes[NORMAL]) && empty(venue.lanes[URGENT]))
+                break;
+            // the next order is being pushed, or not yet created
+            venue.sending.wait(seen, INF, venue.process_stats);
         }
+        else if (t > Order::get_time_now()) {
+            // throttled: nothing can be sent to this venue before the order's time to
+            // send, but an urgent order, or an aged one if allowed the reserve
+            if (urgent_lane)
+                venue.urgent.wait(seen_urgent, monotonic_now() + (t - Order::get_time_now()),
+                                  venue.process_stats);
+            else
+                wait_until(Order::get_clock(), Order::get_time_begin() + t, venue.process_stats);
+        }
+    }
+    // the exchange answers the last orders
+    if (venue.transport)
+        venue.transport->finish();
+    order_path_allocations.fetch_add(venue.dispatch_allocations);
+    venue.process_stats.cpu = thread_cpu_time();
+    venue.process_stats.wall = Order::get_time_now() - wall;
+    // the last venue done lets the printing thread finish
+    if (venues_done.fetch_add(1) + 1 == static_cast<int>(venues.size())) {
+        process_done.store(true);
+        to_print.wake();
     }
-    process_done = true;
 }
 
-// let go or block an order
-bool System::let_go(Order & order, const deque<Order> & sent)
+// the next order of a lane if it is at the head of a queue, looking from the queue
+// it was last found at
+Order * System::head(Fifo & lane)
 {
-    // have only sent a few orders in total (let go)
-    const auto MAX = p->get_max_orders();
-    if (sent.size() < MAX)
-        return true;
+    auto & to_send = lane.to_send;
+    size_t & k = lane.next_lane;
+    for (size_t i = 0; i != to_send.size(); ++i) {
+        Order * order = to_send[k]->front();
+        if (order && order->get_seq() == lane.next_seq)
+            return order;
+        k = k + 1 == to_send.size() ? 0 : k + 1;
+    }
+    return nullptr;
+}
 
-    // not yet time to send (block)
-    Time t = order.get_time_to_send();
-    if (t > Order::get_time_now())
-        return false;
+// the order of a fair lane that took the first place of those at the heads of the
+// queues, while the limits let orders go as they come
+Order * System::oldest(Fifo & lane)
+{
+    Order * first = nullptr;
+    for (size_t k = 0; k != lane.to_send.size(); ++k) {
+        Order * order = lane.to_send[k]->front();
+        if (order && (!first || order->get_seq() < first->get_seq())) {
+            first = order;
+            lane.next_lane = k;
+        }
+    }
+    return first;
+}
+
+// the next order of a fair lane while the limits hold orders back, by deficit
+// round-robin: the traders with orders queued take turns, each sending up to its
+// weight in orders per turn; a trader with none queued saves no turns for later
+Order * System::fair_head(Fifo & lane)
+{
+    auto & to_send = lane.to_send;
+    size_t & k = lane.next_lane;
+    for (size_t i = 0; !to_send.empty() && i <= to_send.size(); ++i) {
+        Order * order = to_send[k]->front();
+        if (order && lane.deficits[k])
+            return order;
+        if (!order)
+            lane.deficits[k] = 0;
+        k = k + 1 == to_send.size() ? 0 : k + 1;
+        if (to_send[k]->front())
+            lane.deficits[k] += lane.weights[k];
+    }
+    return nullptr;
+}
+
+// the next order of a venue at time now, its lane, and the places of the windows
+// it must leave free: the urgent order first, unless the normal one has waited
+// for the aging time and is older; a normal order leaves the reserve free unless
+// aged. A fair lane takes turns across the traders from a throttle until the
+// backlog it left is sent. Cancelled orders on the way are dropped.
+Order * System::next(Venue & venue, Time now, Fifo * & lane, size_t & reserve)
+{
+    const bool backlog = venue.throttled || venue.drain_from != INF;
+    auto first = [&](Fifo & l) {
+        return l.weights.empty() ? head(l) : backlog ? fair_head(l) : oldest(l);
+    };
+    for (;;) {
+        Order * urgent = first(venue.lanes[URGENT]);
+        Order * normal = first(venue.lanes[NORMAL]);
+        const Time AGE = p->get_aging();
+        const bool aged = normal && AGE > Time::zero() && now - normal->get_time_created() >= AGE;
+        Order * order;
+        if (urgent && !(aged && normal->get_id() < urgent->get_id())) {
+            lane = &venue.lanes[URGENT];
+            reserve = 0;
+            order = urgent;
+        }
+        else {
+            lane = &venue.lanes[NORMAL];
+            reserve = aged ? 0 : p->get_reserve();
+            order = normal;
+        }
+        if (!order || !order->is_cancelled())
+            return order;
+        // cancelled while queued: dropped, and no place of the windows taken
+        lane->pop(false);
+        ++venue.cancelled;
+    }
+}
 
+// send the orders of venue # v to the exchange, through a connection of its own; not
+// in a simulation, whose time the exchange does not share
+void System::connect(Venue & venue, size_t v)
+{
+    if (p->is_simulation()) {
+        if (v == 0)
+            cout << "Not sending to the exchange in simulated time" << endl;
+        return;
+    }
+    unique_ptr<SocketTransport> transport(new SocketTransport(p->get_exchange()));
+    if (!transport->is_connected()) {
+        cout << "Failed to connect venue # " << (v + 1) << " to the exchange at "
+             << p->get_exchange() << ": " << transport->get_error() << endl;
+        return;
+    }
+    venue.transport = move(transport);
+    venue.outbox.resize(std::min(p->get_batch(), Venue::OUTBOX));
+}
+
+// go on where the runs in the journal stopped, and begin this one in it: queue
+// their pending orders again, ahead of the new ones, let the limiters and audits
+// know of the sends the rules still count, and take new ids after theirs. If the
+// last run crashed, the sends it made after its last commit are unknown, so the
+// limiters hold every window full from the restart, and any of its pending orders
+// may have been sent: they are marked unknown and not sent again, unless asked
+void System::recover(std::int64_t epoch)
+{
+    recovery = replay(p->get_journal());
+    to_print.append(LogRecord{LogRecord::BEGIN, p->is_simulation(), 0, 0, epoch, 0});
+    const int NTR = p->get_num_traders();
+    const int NVN = static_cast<int>(venues.size());
+    const Time now = Order::get_time_now();
+    tickets.store(recovery.last_id);
+
+    // the sends of each venue, in the order they were made; a simulation's times
+    // are not on the clock of a real run
+    vector<vector<std::int64_t>> sends(NVN);
+    for (size_t field = 0; field < recovery.sends.size() && !p->is_simulation(); ++field) {
+        auto & to = sends[(field ? field - 1 : 0) % NVN];
+        to.insert(to.end(), recovery.sends[field].begin(), recovery.sends[field].end());
+    }
+    for (int v = 0; v != NVN; ++v) {
+        Venue & venue = *venues[v];
+        // what the rules may still count: the last max sends, within the longest window
+        Time longest = Time::zero();
+        size_t most = 0;
+        for (const auto & rule : venue.limiter.get_rules()) {
+            longest = std::max(longest, rule.len);
+            most = std::max(most, rule.max);
+        }
+        std::sort(sends[v].begin(), sends[v].end());
+        for (size_t i = sends[v].size() > most ? sends[v].size() - most : 0; i < sends[v].size(); ++i) {
+            const Time t(sends[v][i] - epoch);
+            if (t <= -longest)
+                continue;
+            venue.limiter.record(t);
+            venue.pacer.record(t);
+            venue.audit.remember(t);
+            venue.last_sent = std::max(venue.last_sent, t);
+            ++remembered;
+        }
+        // the lost sends were made before now, as many as a window let out: counted
+        // as made now, they leave each window no earlier than they could have
+        if (recovery.cut && !p->is_simulation())
+            for (size_t i = 0; i != most; ++i)
+                venue.limiter.record(now);
+    }
+
+    const bool sent_maybe = recovery.cut && !p->is_simulation() && !p->resends_unknown();
+    for (const auto & o : recovery.pending) {
+        if (sent_maybe) {
+            // in this run's part of the journal, for the next runs not to send it either
+            to_print.append(LogRecord{LogRecord::UNKNOWN, o.urgent, o.trader, o.id, now.count(),
+                                      o.venue}, false);
+            ++unknown;
+            continue;
+        }
+        const int trader = (std::max(o.trader, 1) - 1) % NTR + 1;
+        const int v = (o.venue ? o.venue - 1 : 0) % NVN;
+        const Priority priority = o.urgent && p->get_urgent_share() > 0 ? URGENT : NORMAL;
+        Fifo & lane = venues[v]->lanes[priority];
+        auto & queue = *lane.to_send[trader - 1];
+        // the others stay pending in the journal, for the next run
+        if (queue.size() >= p->get_queue_capacity()) {
+            ++unqueued;
+            continue;
+        }
+        queue.try_push(Order(o.id, trader, v, priority, lane.tickets.fetch_add(1) + 1,
+                             o.quantity, o.price, Time(o.created - epoch)));
+        if (!pending.empty())
+            pending[trader - 1]->insert(o.id, queue.back());
+        ++requeued;
+    }
+    to_print.flush();
+    recovery.pending = vector<Recovery::Pending>();
+    recovery.sends = vector<vector<std::int64_t>>();
+}
+
+// close the run in the journal, once all of it is committed, so that a restart
+// knows its sends are all there
+void System::finish()
+{
+    if (to_print.is_journal() && !to_print.get_failed())
+        to_print.append(LogRecord{LogRecord::END, p->is_simulation(), 0, 0,
+                                  Order::get_time_now().count(), 0});
+}
+
+// let go or block an order, leaving reserve places of each window free
+bool System::let_go(Venue & venue, Order & order, size_t reserve)
+{
     // ***** KEY *****
     // { sent more than 10 orders in the past 1 second } is equivalent to
-    // { the 10-th order from last was sent within 1 second from now }
-    Time s = sent[sent.size() - MAX].get_time_sent();
+    // { the 10-th order from last was sent within 1 second from now },
+    // for each rule of the venue in turn, see limiter.hpp; and no earlier than the
+    // pacer spaces it, if pacing
+    const Time now = Order::get_time_now();
+    const Time t = std::max(venue.limiter.earliest(now, reserve), venue.pacer.earliest(now));
 
     // has waited for enough time (let go)
-    const auto LEN = p->get_monitor_length();
-    if (t > s && t - s >= LEN) {
+    if (t <= now)
         return true;
-    }
     // sent too many orders in too short a time (block and reschedule)
-    else {
-        order.set_time_to_send(s + LEN);
-        return false;
-    }
+    order.set_time_to_send(t);
+    return false;
 }
 
-void System::print(deque<string> & to_print, const bool & process_done)
+void System::print(Logger & to_print, const atomic<bool> & process_done)
 {
-    while (!(process_done && to_print.empty())) {
-        if (!to_print.empty()) {
-            # pragma omp critical (printing)
-            {
-                cout << to_print.front();
-                to_print.pop_front();
-            }
-        }
-    }
+    const Time wall = Order::get_time_now();
+    to_print.run(process_done, print_stats);
+    print_stats.cpu = thread_cpu_time();
+    print_stats.wall = Order::get_time_now() - wall;
 }
 
 void Spec::configure()
@@ -241,10 +1131,10 @@ void Spec::configure()
                         { return 0 < ntr && ntr <= MAX_NTR; }));
 
     cout << "Enter length of monitored interval in milliseconds"
-            " (default = " << LEN << " ms): ";
+            " (default = " << to_ms(LEN) << " ms): ";
     input(LEN, function<bool(const decltype(LEN) &)>
                         ([](const decltype(LEN) & len)
-                        { return 0 < len; }));
+                        { return Time::zero() < len; }));
 
     cout << "Enter max number of orders permitted to send in an interval"
             " (default = " << MAX << "): ";
@@ -254,10 +1144,10 @@ void Spec::configure()
 
     cout << "Enter cycle of order generation in ms"
             " (shorter cycle => faster generation, default = "
-         << CYC << " ms): ";
+         << to_ms(CYC) << " ms): ";
     input(CYC, function<bool(const decltype(CYC) &)>
                         ([](const decltype(CYC) & cyc)
-                        { return 0 < cyc; }));
+                        { return Time::zero() < cyc; }));
 }
 
 template<typename T>
@@ -274,12 +1164,220 @@ void Spec::input(T & t, function<bool(const T &)> f)
     cout << endl;
 }
 
+void Spec::input(Time & t, function<bool(const Time &)> f)
+{
+    long long ms = to_ms(t);
+    input(ms, function<bool(const long long &)>
+              ([&](const long long & m) { return f(milliseconds(m)); }));
+    t = milliseconds(ms);
+}
+
+// MAX/LEN in milliseconds, e.g. 500/60000
+bool Spec::parse_rule(const string & value, vector<Rule> & rules)
+{
+    istringstream iss(value);
+    size_t max;
+    long long len;
+    char slash;
+    if (!(iss >> max >> slash >> len) || slash != '/' || max == 0 || len <= 0 || iss.get() != EOF)
+        return false;
+    rules.push_back(Rule{max, milliseconds(len)});
+    return true;
+}
+
+// the limits of one more venue, MAX/LEN[,MAX/LEN...], e.g. 10/1000,500/60000
+bool Spec::parse_venue(const string & value)
+{
+    vector<Rule> rules;
+    istringstream iss(value);
+    for (string rule; getline(iss, rule, ','); )
+        if (!parse_rule(rule, rules))
+            return false;
+    if (rules.empty() || VEN.size() == MAX_NVN)
+        return false;
+    VEN.push_back(move(rules));
+    return true;
+}
+
+// a positive count; a share in [0, 1]; a duration in milliseconds, may have a
+// fraction, 0 if zero_ok
+static bool parse_count(const string & s, size_t & n)
+{
+    char * end = nullptr;
+    const auto v = std::strtoull(s.c_str(), &end, 10);
+    if (s.empty() || *end || v == 0)
+        return false;
+    n = v;
+    return true;
+}
+static bool parse_share(const string & s, double & x)
+{
+    char * end = nullptr;
+    const double v = std::strtod(s.c_str(), &end);
+    if (s.empty() || *end || !(0 <= v && v <= 1))
+        return false;
+    x = v;
+    return true;
+}
+static bool parse_ms(const string & s, Time & t, bool zero_ok = false)
+{
+    char * end = nullptr;
+    const double v = std::strtod(s.c_str(), &end);
+    if (s.empty() || *end || v < 0 || (v == 0 && !zero_ok))
+        return false;
+    t = Time(static_cast<Time::rep>(v * 1e6));
+    return true;
+}
+
+// a non-empty list of values separated by commas, each as parse(string, T &) reads it
+template<typename T, typename F>
+static bool parse_list(const string & s, vector<T> & list, F parse)
+{
+    vector<T> values;
+    istringstream iss(s);
+    for (string one; getline(iss, one, ','); ) {
+        values.emplace_back();
+        if (!parse(one, values.back()))
+            return false;
+    }
+    if (values.empty())
+        return false;
+    list = move(values);
+    return true;
+}
+
+// ROLE:CPU[,CPU...] to pin, ROLE:KB for a stack, ROLE one of trader, process, print
+bool Spec::parse_placement(const string & name, const string & value)
+{
+    static const string roles[] = {"trader", "process", "print"};
+    const auto colon = value.find(':');
+    const auto r = std::find(roles, roles + ROLES, value.substr(0, colon)) - roles;
+    if (colon == string::npos || r == ROLES)
+        return false;
+    const string rest = value.substr(colon + 1);
+    size_t kb;
+    if (name == "pin")
+        return parse_list(rest, PLC[r].cpus, [](const string & s, int & cpu) {
+            char * end = nullptr;
+            const long v = std::strtol(s.c_str(), &end, 10);
+            cpu = static_cast<int>(v);
+            return !s.empty() && !*end && 0 <= v && v < CPU_SETSIZE;
+        });
+    if (!parse_count(rest, kb))
+        return false;
+    PLC[r].stack = kb << 10;
+    return true;
+}
+
+void Spec::parse(int argc, char * argv[])
+{
+    parse(vector<string>(argv + 1, argv + argc));
+}
+
+void Spec::parse(const vector<string> & options)
+{
+    size_t n = 0;
+    for (const string & arg : options) {
+        if (arg.compare(0, 2, "--") != 0)
+            continue;
+        auto eq = arg.find('=');
+        string name = arg.substr(2, eq == string::npos ? string::npos : eq - 2);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (name == "orders" && parse_count(value, n) && n <= MAX_NOD)
+            NOD = n;
+        else if (name == "traders" && parse_count(value, n) && n <= static_cast<size_t>(MAX_NTR))
+            NTR = static_cast<int>(n);
+        else if (name == "max" && parse_count(value, n))
+            MAX = n;
+        else if (name == "len" && parse_ms(value, LEN))
+            ;
+        else if (name == "cycle" && parse_ms(value, CYC, true))
+            ;
+        else if (name == "batch" && parse_count(value, n))
+            BAT = n;
+        else if (name == "urgent" && parse_share(value, URG))
+            ;
+        else if (name == "aging" && parse_ms(value, AGE, true))
+            ;
+        else if (name == "cycles" && parse_list(value, CYT, [](const string & s, Time & t) {
+                                                            return parse_ms(s, t, true); }))
+            ;
+        else if (name == "fair" && value.empty()) {
+            if (WGT.empty())
+                WGT.push_back(1);
+        }
+        else if (name == "weights" && parse_list(value, WGT, parse_count))
+            ;
+        else if (name == "pace" && parse_count(value, n))
+            PAC = n;
+        else if (name == "cancel" && parse_share(value, CNL))
+            ;
+        else if (name == "amend" && parse_share(value, AMD))
+            ;
+        else if (name == "reserve" && (value == "0" || parse_count(value, n)))
+            RSV = value == "0" ? 0 : n;
+        else if (name == "clock" && (value == "steady" || value == "tsc"))
+            CLK = value;
+        else if (name == "sent-capacity" && std::atoll(value.c_str()) > 0)
+            SCP = std::atoll(value.c_str());
+        else if (name == "sent-file" && !value.empty())
+            SFL = value;
+        else if (name == "sim" && value.empty())
+            SIM = true;
+        else if (name == "seed" && !value.empty())
+            SED = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (name == "quiet" && value.empty())
+            QUI = true;
+        else if (name == "resend-unknown" && value.empty())
+            RSU = true;
+        else if (name == "exchange" && !value.empty())
+            EXC = value;
+        else if (name == "guard" && parse_ms(value, GRD, true))
+            ;
+        else if (name == "json" && !value.empty())
+            JSN = value;
+        else if (name == "log")
+            LOG = value;
+        else if (name == "journal" && !value.empty())
+            JRN = value;
+        else if (name == "log-overflow" && (value == "block" || value == "drop"))
+            OVF = value == "block" ? Overflow::BLOCK : Overflow::DROP;
+        else if (name == "limit" && parse_rule(value, RUL))
+            ;
+        else if (name == "venue" && parse_venue(value))
+            ;
+        else if (name == "threads" && value.empty())
+            THR = true;
+        else if ((name == "pin" || name == "stack") && parse_placement(name, value))
+            THR = true;
+        else if (name == "fifo" && parse_count(value, n) && n <= 99) {
+            PLC[PROCESSING].fifo = static_cast<int>(n);
+            THR = true;
+        }
+        else if (name == "wait" && parse_wait(value, WPR))
+            WPN = WPR;
+        else if (name == "wait-process" && parse_wait(value, WPR))
+            ;
+        else if (name == "wait-print" && parse_wait(value, WPN))
+            ;
+        else
+            cout << "Ignored option " << arg << endl;
+    }
+}
+
+#ifndef ORDER_NO_MAIN
 int main(int argc, char * argv[])
 {
-    bool factory_mode = (argc != 1);
+    // any argument other than an option turns on factory mode
+    bool factory_mode = false;
+    for (int i = 1; i < argc; ++i)
+        if (string(argv[i]).compare(0, 2, "--") != 0)
+            factory_mode = true;
     Spec spec(factory_mode);
+    spec.parse(argc, argv);
     System sys(spec);
     sys.start(factory_mode);
     sys.report();
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -63,19 +63,27 @@
 
 // 2. Thread # 1 to # 3 for the 3 traders;
 
-// 3. Thread # 4 to process the orders -- to let go or block in real time.
+// 3. Thread # 4 to process the orders -- to let go or block in real time (one
+//    processing thread for each venue, # 4 and on, if there are several).
 
-// We need 3 queues. Each should be accessed by only 1 thread at a time:
+// We need 3 queues:
 
-// 1. a [to_print] queue of strings to print messages in progress;
+// 1. [to_print] queues of log records to print messages in progress, one
+//    lock-free single-producer queue for each trader and one for the processing
+//    thread; a record is plain data (ids and times), formatted and written in
+//    batches by the printing thread, see log.hpp;
 
-// 2. a [to_send] queue of orders to schedule orders yet to send;
+// 2. [to_send] lock-free single-producer queues of orders to schedule orders yet
+//    to send, one for each trader, emptied by the processing thread in the order
+//    of the ids: a trader takes the id of an order, and with it the quota of
+//    orders to generate, by one atomic increment of a shared ticket counter;
 
-// 3. a [sent] queue of orders to record sent orders.
+// 3. a [sent] log of orders to record sent orders, owned by the processing
+//    thread: a ring of fixed capacity whose older records spill to a file.
 
 // When an order is created, it is immediately enqueued to [to_send].
 
-// When it is sent, it is moved from [to_send] to [sent] (dequeue and enqueue).
+// When it is sent, it is dequeued from [to_send] and recorded in [sent].
 
 // [设计]
 
@@ -85,43 +93,58 @@
 
 // 2. 第1 ~ 3号线程，对应第1 ~ 3号交易机器；
 
-// 3. 第4号线程，用于处理订单，包括实时决定放行或禁行。
+// 3. 第4号线程，用于处理订单，包括实时决定放行或禁行（若有多个交易场所，则每个场所
+//    各一条处理线程，自第4号起）。
 
-// 同时，本程序需要3条队列。每条队列的入队或出队在一个时刻只供一条线程操作：
+// 同时，本程序需要3条队列：
 
-// 1. [to_print] 队列，用于打印输出处理中的信息；
+// 1. [to_print] 队列，用于打印输出处理中的信息。每台交易机器和处理线程各有一条无锁
+//    单生产者队列；队列中的记录只含编号与时间，由打印线程格式化；
 
-// 2. [to_send] 队列，用于计划未发送订单；
+// 2. [to_send] 无锁单生产者队列，用于计划未发送订单，每台交易机器各一条，处理线程按
+//    订单编号顺序出队；交易机器以一次原子自增领取订单编号及生成配额；
 
-// 3. [sent] 队列，用于记录已发送订单。
+// 3. [sent] 日志，用于记录已发送订单，仅由处理线程操作：容量固定的环形缓冲区，较早的
+//    记录写入文件。
 
 // 当创建1笔订单是，该订单立刻进入 [to_send] 队列。
 
-// 系统在发送该订单后，将该订单从 [to_send] 队列移至 [sent] 队列（先出队再入队）。
+// 系统在发送该订单后，将该订单从 [to_send] 队列出队，并记入 [sent] 日志。
 
 #ifndef ORDER_HPP
 #define ORDER_HPP
 
+#include <algorithm>
 #include <cstddef>
-#include <ctime>
-#include <deque>
+#include <cstdint>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <omp.h>
 #include <random>
-#include <set>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <utility>
-#include <windows.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "index.hpp"
+#include "journal.hpp"
+#include "limiter.hpp"
+#include "log.hpp"
+#include "queue.hpp"
+#include "sentlog.hpp"
+#include "thread.hpp"
+#include "transport.hpp"
+#include "wait.hpp"
 
 using std::bernoulli_distribution;
 using std::cin;
-using std::clock_t;
 using std::cout;
 using std::default_random_engine;
-using std::deque;
+using std::atomic;
 using std::endl;
 using std::fixed;
 using std::function;
@@ -129,19 +152,17 @@ using std::getline;
 using std::istringstream;
 using std::move;
 using std::ostringstream;
-using std::set;
 using std::setprecision;
 using std::size_t;
 using std::string;
-using Time = std::size_t;
-
-constexpr Time INF = -1;
+using std::unique_ptr;
+using std::vector;
 
 // convert Time to string (in seconds)
 inline string to_second(Time t)
 {
     ostringstream oss;
-    oss << fixed << setprecision(3) << (static_cast<double>(t) / CLOCKS_PER_SEC) << " s";
+    oss << fixed << setprecision(3) << (static_cast<double>(t.count()) / 1e9) << " s";
     return oss.str();
 }
 
@@ -161,58 +182,178 @@ inline void line(const string & title)
     cout << oss.str();
 }
 
+#ifdef ORDER_COUNT_ALLOCATIONS
+// heap allocations made by the calling thread, counted by the operator new of the
+// test build (test.cpp)
+extern thread_local size_t allocations;
+#else
+static constexpr size_t allocations = 0;        // not counted
+#endif
+
+// the priority lanes of a venue, served from the highest
+enum Priority : int { NORMAL, URGENT, PRIORITIES };
+
+// the roles of the threads of a run, each placed on its own with dedicated threads
+enum Role : int { TRADING, PROCESSING, PRINTING, ROLES };
+
+// where a queued order is: waiting, taken by one side to send or amend it, or out
+// of the queue; an atomic that copies, for an order built before it is shared
+struct OrderState
+{
+    enum : int { PENDING, CLAIMED, SENT, CANCELLED };
+
+    std::atomic<int> value{PENDING};
+
+    OrderState() = default;
+    OrderState(const OrderState & s) : value(s.value.load(std::memory_order_relaxed)) {}
+};
+
 class Order
 {
     const size_t  id;
     const int     creator;
+    const int     venue;                // routed to, from 0
+    const Priority priority;
+    const size_t  seq;                  // place in the FIFO of its lane at the venue, from 1
     const Time    time_created;
     Time          time_to_send;
     Time          time_sent = INF;
+    std::int64_t  quantity;
+    std::int64_t  price;                // in ticks
+    OrderState    state;                // the trader may cancel or amend it while queued
     
-    static size_t   counter;
-    static clock_t  begin;
+    static const Clock *    clock;
+    static Time             begin;
 
 public:
     
-    Order(int trader_id)
-        : id(increment()), creator(trader_id),
-          time_created(get_time_now()), time_to_send(time_created) {}
+    Order(size_t order_id, int trader_id, int venue_id, Priority p, size_t venue_seq,
+          std::int64_t qty = 100, std::int64_t px = 10000)
+        : id(order_id), creator(trader_id), venue(venue_id), priority(p), seq(venue_seq),
+          time_created(get_time_now()), time_to_send(time_created), quantity(qty), price(px) {}
+    // an order of an earlier run, created at the given time since begin
+    Order(size_t order_id, int trader_id, int venue_id, Priority p, size_t venue_seq,
+          std::int64_t qty, std::int64_t px, Time created)
+        : id(order_id), creator(trader_id), venue(venue_id), priority(p), seq(venue_seq),
+          time_created(created), time_to_send(created), quantity(qty), price(px) {}
 
     size_t  get_id() const              { return id;           }
     int     get_creator() const         { return creator;      }
+    int     get_venue() const           { return venue;        }
+    Priority get_priority() const       { return priority;     }
+    size_t  get_seq() const             { return seq;          }
     Time    get_time_created()  const   { return time_created; }
     Time    get_time_to_send()  const   { return time_to_send; }
     Time    get_time_sent() const       { return time_sent;    }
+    std::int64_t get_quantity() const   { return quantity;     }
+    std::int64_t get_price() const      { return price;        }
+    bool    is_cancelled() const        { return state.value.load() == OrderState::CANCELLED; }
+
+    // take a queued order to send or amend it, waiting while the other side has
+    // it; false if it is out of the queue
+    bool claim()
+    {
+        for (int s = OrderState::PENDING;
+             !state.value.compare_exchange_weak(s, OrderState::CLAIMED); s = OrderState::PENDING) {
+            if (s == OrderState::SENT || s == OrderState::CANCELLED)
+                return false;
+            cpu_relax();
+        }
+        return true;
+    }
+    void release()                      { state.value.store(OrderState::PENDING); }
+    // withdraw a queued order; false if it is being sent or out of the queue
+    bool cancel()
+    {
+        int s = OrderState::PENDING;
+        return state.value.compare_exchange_strong(s, OrderState::CANCELLED);
+    }
+    // patch a claimed order
+    void amend(std::int64_t qty, std::int64_t px)
+    {
+        quantity = qty;
+        price = px;
+    }
     
-    static size_t get_orders_created()  { return counter;                            }
-    static  Time  get_time_now()        { return static_cast<Time>(clock() - begin); }
+    static  Time  get_time_now()        { return clock->now() - begin;  }
+    static  Time  get_time_begin()      { return begin;                 }
+    static const Clock & get_clock()    { return *clock;                }
+
+    // sleep until time t since begin
+    static void sleep_until(Time t)     { clock->sleep_until(begin + t); }
+    static void sleep_for(Time d)       { clock->sleep_for(d);           }
 
 private:
 
-    void set_time_to_send(Time t)       { time_to_send = t; }
-    void set_time_sent(Time t)          { time_sent = t;    }
-    static void reset_time_begin()      { begin = clock();  }
-    static size_t increment()
+    void set_time_to_send(Time t)       { time_to_send = t;      }
+    void set_time_sent(Time t)          { time_sent = t;         }
+    void set_sent()                     { state.value.store(OrderState::SENT); }
+    static void reset_time_begin()      { begin = clock->now();  }
+    static void use_clock(const Clock * c)
     {
-        size_t c; 
-        # pragma omp critical (initializing)
-        {
-            c = (counter += 1);
-        }
-        return c;
+        clock = c;
+        reset_time_begin();
     }
 friend class System;
 };
 
+// a popped order keeps its state until its trader reuses the slot, see SlotIndex
+static_assert(std::is_trivially_destructible<Order>::value, "orders are popped in place");
+
+// what submitting orders costs a trader, kept by that trader only
+struct alignas(CACHE_LINE) SubmitStats
+{
+    Histogram   submit;                     // from taking a ticket to notifying
+    size_t      created     = 0;            // orders, sent or not
+    size_t      cancels     = 0;            // tried
+    size_t      cancelled   = 0;            // in time, still queued
+    size_t      amends      = 0;
+    size_t      amended     = 0;
+};
+
 class Spec
 {
     size_t  NOD = 100;                          // # of orders to generate
     int     NTR = 3;                            // # of traders
-    Time    LEN = CLOCKS_PER_SEC;               // length of monitoring interval
+    Time    LEN = seconds(1);                   // length of monitoring interval
     size_t  MAX = 10;                           // max # of orders in interval
-    Time    CYC = 100;                          // cycle of order generation
+    vector<Rule> RUL;                           // further limits, e.g. 500 a minute
+    vector<vector<Rule>> VEN;                   // venues with their own limits, if any
+    Time    CYC = milliseconds(100);            // cycle of order generation
+    vector<Time> CYT;                           // cycles of the first traders, if not CYC
+    size_t  QCP = 1 << 12;                      // capacity of each [to_send] queue
+    size_t  BAT = 1;                            // max # of orders sent in one pass
+    double  URG = 0;                            // share of orders created urgent
+    Time    AGE = Time::zero();                 // a normal order waiting so long is
+                                                // served as urgent; 0 for never
+    size_t  RSV = 0;                            // places of each window kept for urgent
+    size_t  PAC = 0;                            // burst of paced sends; 0 for no pacing
+    vector<size_t> WGT;                         // weights of the first traders (the others
+                                                // weigh 1) when fair; empty for FIFO
+    double  CNL = 0;                            // share of cycles a trader cancels an order
+    double  AMD = 0;                            // share of cycles a trader amends an order
+    size_t  PCP = 1 << 12;                      // capacity of each [to_print] queue
+    Overflow OVF = Overflow::BLOCK;             // when a [to_print] queue is full
+    string  LOG;                                // binary log file, if any
+    string  JRN;                                // journal to recover from and append to
+    string  JSN;                                // file to export the report to, if any
+    string  EXC;                                // socket of an exchange to send to, if any
+    Time    GRD = Time::zero();                 // margin the limiter adds to each window
+    bool    SIM = false;                        // simulate in virtual time, one thread
+    unsigned SED = 0;                           // seed of the traders' random engines
+    bool    QUI = false;                        // print neither events nor the log
+    bool    RSU = false;                        // queue again the pending orders of a
+                                                // crashed run, which it may have sent
+    size_t  SCP = 1 << 12;                      // capacity of the [sent] ring
+    string  SFL = "sent.bin";                   // file the [sent] ring spills to
+    string  CLK = "steady";                     // clock: steady or tsc
+    Wait    WPR = Wait::FUTEX;                  // wait strategy of process
+    Wait    WPN = Wait::FUTEX;                  // wait strategy of print
+    bool    THR = false;                        // a dedicated thread for each role, not OpenMP
+    Placement PLC[ROLES];                       // of the threads of each role
     static constexpr size_t  MAX_NOD = 1000000; // max # of orders possible
     static constexpr int     MAX_NTR = 100;     // max # of traders possible
+    static constexpr size_t  MAX_NVN = 16;      // max # of venues possible
 
 public:
 
@@ -221,11 +362,66 @@ public:
         if (factory_mode)
             configure();
     }
+    // options --name=value from the command line, see main
+    void parse(int argc, char * argv[]);
+    void parse(const vector<string> & options);
     size_t get_num_orders_to_gen() const    { return NOD; }
     int get_num_traders() const             { return NTR; }
     Time get_monitor_length() const         { return LEN; }
     size_t get_max_orders() const           { return MAX; }
-    size_t get_order_cycle() const          { return CYC; }
+    // the limit above followed by the further ones
+    vector<Rule> get_rules() const
+    {
+        vector<Rule> rules{Rule{MAX, LEN}};
+        rules.insert(rules.end(), RUL.begin(), RUL.end());
+        return rules;
+    }
+    // the limits of each venue: one venue under the limits above unless given
+    vector<vector<Rule>> get_venues() const
+    {
+        return VEN.empty() ? vector<vector<Rule>>{get_rules()} : VEN;
+    }
+    int get_num_venues() const              { return VEN.empty() ? 1 : static_cast<int>(VEN.size()); }
+    Time get_order_cycle() const            { return CYC; }
+    Time get_order_cycle(int trader) const      // trader from 1
+    {
+        return static_cast<size_t>(trader) <= CYT.size() ? CYT[trader - 1] : CYC;
+    }
+    size_t get_queue_capacity() const       { return QCP; }
+    size_t get_batch() const                { return BAT; }
+    double get_urgent_share() const         { return URG; }
+    Time get_aging() const                  { return AGE; }
+    size_t get_reserve() const              { return RSV; }
+    size_t get_pace_burst() const           { return PAC; }
+    bool is_fair() const                    { return !WGT.empty(); }
+    // the weight of each trader if fair, else none
+    vector<size_t> get_weights() const
+    {
+        vector<size_t> weights;
+        for (int i = 0; is_fair() && i != NTR; ++i)
+            weights.push_back(static_cast<size_t>(i) < WGT.size() ? WGT[i] : 1);
+        return weights;
+    }
+    double get_cancel_share() const         { return CNL; }
+    double get_amend_share() const          { return AMD; }
+    size_t get_print_capacity() const       { return PCP; }
+    Overflow get_print_overflow() const     { return OVF; }
+    const string & get_log_file() const     { return LOG; }
+    const string & get_journal() const      { return JRN; }
+    const string & get_json_file() const    { return JSN; }
+    const string & get_exchange() const     { return EXC; }
+    Time get_guard() const                  { return GRD; }
+    bool is_simulation() const              { return SIM; }
+    unsigned get_seed() const               { return SED; }
+    bool is_quiet() const                   { return QUI; }
+    bool resends_unknown() const            { return RSU; }
+    size_t get_sent_capacity() const        { return SCP; }
+    const string & get_sent_file() const    { return SFL; }
+    const string & get_clock() const        { return CLK; }
+    Wait get_process_wait() const           { return WPR; }
+    Wait get_print_wait() const             { return WPN; }
+    bool uses_threads() const               { return THR; }
+    const Placement & get_placement(Role r) const { return PLC[r]; }
     size_t get_max_orders_in_total() const  { return MAX_NOD; }
     int get_max_num_traders() const         { return MAX_NTR; }
 
@@ -234,35 +430,238 @@ private:
     void configure();
     template<typename T>
     void input(T & t, function<bool(const T &)> = [](const T &){ return true; });
+    void input(Time & t, function<bool(const Time &)>);     // in milliseconds
+    bool parse_rule(const string &, vector<Rule> &);
+    bool parse_venue(const string &);
+    bool parse_placement(const string &, const string &);
+};
+
+// the FIFO of a priority lane at a venue: a queue for each trader, emptied in the
+// order of the places taken, unless fair
+struct Fifo
+{
+    vector<unique_ptr<SpscRing<Order>>> to_send;    // one for each trader
+    atomic<size_t>  tickets{0};                     // places taken
+    size_t          next_seq            = 1;        // place of the next order to send
+    size_t          next_lane           = 0;        // the queue it was last found at
+    vector<size_t>  weights;                        // of the traders, if fair
+    vector<size_t>  deficits;                       // orders each may still send in its turn
+
+    // dequeue the order found at the head; a sent one uses up one of its trader's turn
+    void pop(bool sent)
+    {
+        to_send[next_lane]->pop();
+        ++next_seq;
+        if (sent && !deficits.empty() && deficits[next_lane])
+            --deficits[next_lane];
+    }
+};
+
+// a venue orders are routed to: its own queues, limits and processing thread, so
+// that a throttled venue never holds back the orders of another. Its urgent lane
+// is served before the normal one, but a normal order that has waited for the
+// aging time is served as urgent; within a lane, orders are sent in the order of
+// their places, or, if fair and the limits hold orders back, by deficit round-robin
+// across the traders
+struct alignas(CACHE_LINE) Venue
+{
+    Fifo            lanes[PRIORITIES];              // the urgent one only if in use
+    Signal          sending;                        // to_send pushed, or a trader done
+    Signal          urgent;                         // an urgent order pushed
+    WaitStats       process_stats;
+    Histogram       dispatching;                    // from finding orders to sending them
+    Histogram       draining;                       // from the end of a throttle to an empty backlog
+    Histogram       batches;                        // orders sent in one pass
+    Histogram       gaps;                           // between passes that sent
+    Time            drain_from          = INF;      // a throttle ended and the backlog is draining
+    bool            throttled           = false;    // an order is blocked
+    Time            blocked_until       = INF;      // last time to send printed for a block
+    size_t          dispatch_allocations = 0;       // on the order path
+    size_t          cancelled           = 0;        // dropped from the queues, not sent
+    Series          depth{milliseconds(1)};         // orders in to_send over time
+    Time            last_sent           = Time::zero();
+    Limiter         limiter;
+    Pacer           pacer;                          // spaces the sends the limiter allows
+    Audit           audit;                          // checks every send against the rules
+    SentLog         sent;
+    unique_ptr<Transport> transport;                // to an exchange, if sending to one
+    vector<WireOrder> outbox;                       // messages of a pass, built in place
+    static constexpr size_t OUTBOX = 1024;          // at most sent at once
+    vector<TraderStats> by_trader;                  // kept as orders are sent
+    Histogram       waits[PRIORITIES];              // from creation to sending, by lane
+
+    // the limiter keeps to windows longer by guard than the rules, so that sends that
+    // reach the exchange closer together than they left keep to them too
+    static vector<Rule> widened(vector<Rule> rules, Time guard)
+    {
+        for (auto & rule : rules)
+            rule.len += guard;
+        return rules;
+    }
+
+    Venue(const vector<Rule> & rules, Time guard, size_t pace_burst, int traders,
+          const vector<size_t> & weights, size_t queue_capacity, bool urgent_lane,
+          size_t sent_capacity, const string & sent_file)
+        : limiter(widened(rules, guard)), pacer(rules, pace_burst), audit(rules), sent(sent_capacity, sent_file),
+          by_trader(traders)
+    {
+        for (int i = 0; i != traders; ++i) {
+            lanes[NORMAL].to_send.emplace_back(new SpscRing<Order>(queue_capacity));
+            if (urgent_lane)
+                lanes[URGENT].to_send.emplace_back(new SpscRing<Order>(queue_capacity));
+        }
+        for (auto & lane : lanes) {
+            lane.weights = weights;
+            lane.deficits.assign(weights.size(), 0);
+        }
+    }
+
+    // orders waiting, in all lanes
+    size_t size() const
+    {
+        size_t n = 0;
+        for (const auto & lane : lanes)
+            for (const auto & q : lane.to_send)
+                n += q->size();
+        return n;
+    }
 };
 
 class System
 {
     const Spec *    p;
-    int             orders_in_progress  = 0;
-    set<size_t> *   orders_by_trader    = nullptr;
-    int             traders_done        = 0;
-    bool            process_done        = false;
-    deque<Order>    to_send;
-    deque<Order>    sent;
-    deque<string>   to_print;
+    unique_ptr<Clock> clock;
+    atomic<size_t>  tickets{0};                     // orders created, or being created
+    atomic<int>     traders_done{0};
+    atomic<int>     venues_done{0};                 // processing threads done
+    atomic<bool>    process_done{false};            // all of them
+    vector<unique_ptr<Venue>> venues;
+    vector<SubmitStats> submit_stats;               // one for each trader
+    vector<unique_ptr<SlotIndex<Order>>> pending;   // one for each trader, if it revises
+    Time            simulated           = Time::zero(); // virtual time of a simulation
+    Time            simulation_wall     = Time::zero(); // real time it took
+    WaitStats       print_stats;
+    vector<string>  placement_errors;               // of the dedicated threads, if any
+    Recovery        recovery;                       // from the journal, if any
+    size_t          requeued            = 0;        // pending orders of it queued again
+    size_t          unqueued            = 0;        // not, their queues were full
+    size_t          unknown             = 0;        // not, the run that had them crashed
+    size_t          remembered          = 0;        // sends of it the rules still count
+    Logger          to_print;                       // traders 1 ~ NTR, then venues
+    atomic<size_t>  order_path_allocations{0};      // from creating to sending orders
 
 public:
 
-    System(const Spec & s) : p(&s), orders_by_trader(new set<size_t>[p->get_num_traders()]()) {}
-    ~System()
+    System(const Spec & s)
+        : p(&s), clock(make_clock(p->is_simulation() ? "virtual" : p->get_clock())),
+          submit_stats(p->get_num_traders()),
+          to_print(p->get_num_traders() + p->get_num_venues(), p->get_print_capacity(),
+                   p->get_journal().empty() ? p->get_print_overflow() : Overflow::BLOCK,
+                   p->get_journal().empty() ? p->get_log_file() : p->get_journal(), p->is_quiet(),
+                   !p->get_journal().empty())
     {
-        delete[] orders_by_trader;
+        Order::use_clock(clock.get());
+        print_stats.strategy = p->get_print_wait();
+        const auto limits = p->get_venues();
+        for (size_t v = 0; v != limits.size(); ++v) {
+            // with several venues, each spills to a file of its own
+            const string file = p->get_sent_file()
+                              + (limits.size() > 1 ? "." + std::to_string(v + 1) : "");
+            venues.emplace_back(new Venue(limits[v], p->get_guard(), p->get_pace_burst(), p->get_num_traders(),
+                                          p->get_weights(), p->get_queue_capacity(), p->get_urgent_share() > 0,
+                                          p->get_sent_capacity(), file));
+            venues.back()->process_stats.strategy = p->get_process_wait();
+            if (!p->get_exchange().empty())
+                connect(*venues.back(), v);
+        }
+        if (p->get_cancel_share() > 0 || p->get_amend_share() > 0)
+            for (int i = 0; i != p->get_num_traders(); ++i)
+                pending.emplace_back(new SlotIndex<Order>(p->get_queue_capacity()));
     }
     void start(bool factory_mode = false);
     void report() const;
+    void export_json(const string &) const;
+    void export_json(std::ostream &) const;
+
+    // results, for benchmarks
+    size_t get_sent() const
+    {
+        size_t n = 0;
+        for (const auto & v : venues)
+            n += v->audit.get_checked();
+        return n;
+    }
+    Time get_last_sent() const              // of any venue
+    {
+        Time last = Time::zero();
+        for (const auto & v : venues)
+            last = std::max(last, v->last_sent);
+        return last;
+    }
+    double get_throughput() const           // orders sent per second, over the run
+    {
+        const Time last = get_last_sent();
+        return last > Time::zero() ? get_sent() / (last.count() / 1e9) : 0;
+    }
+    size_t get_dropped_log_records() const  { return to_print.get_dropped(); }
+    size_t get_order_path_allocations() const   // counted in the test build only
+    {
+        return order_path_allocations.load();
+    }
+    Histogram get_submit_latency() const
+    {
+        Histogram h;
+        for (const auto & s : submit_stats)
+            h.merge(s.submit);
+        return h;
+    }
+    Histogram get_round_trip() const        // to the exchange and back, if any
+    {
+        Histogram h;
+        for (const auto & v : venues)
+            if (v->transport)
+                h.merge(v->transport->get_round_trip());
+        return h;
+    }
+    Histogram get_dispatch_latency() const
+    {
+        Histogram h;
+        for (const auto & v : venues)
+            h.merge(v->dispatching);
+        return h;
+    }
+    Histogram get_wait_latency() const      // from creation to sending
+    {
+        Histogram h;
+        for (const auto & v : venues)
+            for (const auto & w : v->waits)
+                h.merge(w);
+        return h;
+    }
+    int get_num_venues() const              { return static_cast<int>(venues.size()); }
+    const Series & get_queue_depth(int venue) const { return venues[venue]->depth; }
+    const Histogram & get_send_gaps(int venue) const { return venues[venue]->gaps; }
 
 private:
 
-    void generate(int, deque<Order> &, deque<string> &, int &, set<size_t> *, int &);
-    void process(deque<Order> &, deque<Order> &, deque<string> &, const int &, bool &);
-    bool let_go(Order &, const deque<Order> &);
-    void print(deque<string> &, const bool &);
+    void simulate();
+    bool trader_step(int, default_random_engine &, Logger::Producer &, atomic<size_t> &, size_t &,
+                     int &);
+    void revise(int, default_random_engine &, Logger::Producer &);
+    Time dispatch_step(Venue &, Logger::Producer &);
+    void generate(int, Logger::Producer, atomic<size_t> &, atomic<int> &);
+    void process(Venue &, Logger::Producer, const atomic<int> &, atomic<bool> &);
+    Order * head(Fifo &);
+    Order * oldest(Fifo &);
+    Order * fair_head(Fifo &);
+    Order * next(Venue &, Time, Fifo * &, size_t &);
+    bool let_go(Venue &, Order &, size_t);
+    void connect(Venue &, size_t);
+    void recover(std::int64_t);
+    void finish();
+    // the venue field of a log record: its number if there are several, else 0
+    std::int64_t venue_field(int venue) const    { return venues.size() > 1 ? venue + 1 : 0; }
+    void print(Logger &, const atomic<bool> &);
 };
 
 #endif
\ No newline at end of file
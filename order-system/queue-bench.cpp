@@ -0,0 +1,185 @@
+// Microbenchmark of the hand-off queues of the order system
+
+// Compares the lock-free rings of queue.hpp with the critical-guarded deques they
+// replaced, for many producers to one consumer (traders to the dispatcher) and for
+// one producer to one consumer (dispatcher to the logger). Every item carries the
+// time it was pushed; the consumer records the enqueue-to-dequeue latency.
+
+// To compile: g++ queue-bench.cpp -fopenmp -std=c++17 -O2 -o queue-bench
+
+// To run: queue-bench [producers = 3] [items per producer = 200000] [gap between pushes in ns = 0]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "queue.hpp"
+
+using std::cout;
+using std::deque;
+using std::endl;
+using std::string;
+using std::vector;
+using Clock = std::chrono::steady_clock;
+
+struct Item
+{
+    std::int64_t    stamp;      // ns when pushed
+    int             producer;
+};
+
+inline std::int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+inline void spin_for(std::int64_t ns)
+{
+    if (ns <= 0)
+        return;
+    const auto until = now_ns() + ns;
+    while (now_ns() < until)
+        ;
+}
+
+// the queues before: a deque whose every access is inside one critical section
+class LockedDeque
+{
+    deque<Item> items;
+
+public:
+
+    bool try_push(const Item & item)
+    {
+        # pragma omp critical (bench_queue)
+        {
+            items.push_back(item);
+        }
+        return true;
+    }
+    bool try_pop(Item & item)
+    {
+        bool popped = false;
+        # pragma omp critical (bench_queue)
+        {
+            if (!items.empty()) {
+                item = items.front();
+                items.pop_front();
+                popped = true;
+            }
+        }
+        return popped;
+    }
+};
+
+// adapt the rings to the same interface
+template<typename Ring>
+class LockFree
+{
+    Ring ring;
+
+public:
+
+    explicit LockFree(size_t capacity) : ring(capacity) {}
+    bool try_push(const Item & item)    { return ring.try_push(item); }
+    bool try_pop(Item & item)
+    {
+        Item * front = ring.front();
+        if (!front)
+            return false;
+        item = *front;
+        ring.pop();
+        return true;
+    }
+};
+
+struct Result
+{
+    double          seconds;
+    vector<double>  latency;    // ns, sorted
+};
+
+template<typename Q>
+Result run(Q & queue, int producers, long items, long gap)
+{
+    Result result;
+    result.latency.reserve(producers * items);
+    const auto begin = now_ns();
+    # pragma omp parallel num_threads(producers + 1)
+    {
+        const int id = omp_get_thread_num();
+        if (id == producers) {
+            // consumer
+            Item item;
+            for (long n = 0; n != producers * items; ) {
+                if (queue.try_pop(item)) {
+                    result.latency.push_back(static_cast<double>(now_ns() - item.stamp));
+                    ++n;
+                }
+            }
+        }
+        else {
+            for (long i = 0; i != items; ++i) {
+                while (!queue.try_push(Item{now_ns(), id}))
+                    std::this_thread::yield();
+                spin_for(gap);
+            }
+        }
+    }
+    result.seconds = (now_ns() - begin) / 1e9;
+    std::sort(result.latency.begin(), result.latency.end());
+    return result;
+}
+
+void report(const string & name, const Result & r)
+{
+    auto pct = [&](double q) { return r.latency[static_cast<size_t>(q * (r.latency.size() - 1))]; };
+    double mean = 0;
+    for (auto l : r.latency)
+        mean += l;
+    mean /= r.latency.size();
+    cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(0)
+         << std::setw(14) << r.latency.size() / r.seconds
+         << std::setw(12) << mean << std::setw(12) << pct(0.5) << std::setw(12) << pct(0.99)
+         << std::setw(12) << pct(0.999) << std::setw(14) << r.latency.back() << endl;
+}
+
+int main(int argc, char * argv[])
+{
+    const int producers = argc > 1 ? std::atoi(argv[1]) : 3;
+    const long items = argc > 2 ? std::atol(argv[2]) : 200000;
+    const long gap = argc > 3 ? std::atol(argv[3]) : 0;
+    const size_t capacity = 1 << 16;
+
+    cout << "producers " << producers << ", items per producer " << items
+         << ", gap " << gap << " ns, hardware threads " << std::thread::hardware_concurrency() << endl;
+    cout << std::left << std::setw(24) << "queue" << std::right
+         << std::setw(14) << "items/s" << std::setw(12) << "mean ns" << std::setw(12) << "p50 ns"
+         << std::setw(12) << "p99 ns" << std::setw(12) << "p99.9 ns" << std::setw(14) << "max ns" << endl;
+    {
+        LockedDeque q;
+        report("critical deque (MPSC)", run(q, producers, items, gap));
+    }
+    {
+        LockFree<MpscRing<Item>> q(capacity);
+        report("MpscRing", run(q, producers, items, gap));
+    }
+    {
+        LockedDeque q;
+        report("critical deque (SPSC)", run(q, 1, items, gap));
+    }
+    {
+        LockFree<SpscRing<Item>> q(capacity);
+        report("SpscRing", run(q, 1, items, gap));
+    }
+    return 0;
+}
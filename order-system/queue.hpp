@@ -0,0 +1,212 @@
+// Bounded lock-free queues for hand-offs between the threads of the order system
+
+// [SpscRing] one producer, one consumer, e.g. a trader and the dispatcher
+
+// [MpscRing] many producers, one consumer. The system gives each trader its own
+//           SpscRing instead, so only queue-bench.cpp uses it, against the
+//           critical-guarded deque it replaced
+
+// Both hold their elements in place in a ring whose capacity is a power of 2. The
+// head (consumer) and tail (producer) indices live on separate cache lines, so the
+// two sides do not invalidate each other's line on every operation. A push onto a
+// full ring fails and leaves the decision (retry, back off, drop) to the caller.
+
+// The consumer may look at front() and modify it in place before pop(), which is
+// how the dispatcher reschedules a blocked order without dequeuing it. The producer
+// of an SpscRing may keep the back() it pushed, to reach it in place through
+// atomics of the element (how a trader cancels an order still queued).
+
+#ifndef QUEUE_HPP
+#define QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+constexpr std::size_t CACHE_LINE = 64;
+
+// round up to a power of 2
+inline std::size_t ring_capacity(std::size_t n)
+{
+    std::size_t c = 1;
+    while (c < n)
+        c <<= 1;
+    return c;
+}
+
+template<typename T>
+class SpscRing
+{
+    using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    const std::size_t           mask;
+    std::unique_ptr<Slot[]>     slots;
+
+    alignas(CACHE_LINE) std::atomic<std::size_t> head{0};  // next to pop
+    std::size_t                 tail_cache = 0;            // consumer's copy of tail
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail{0};  // next to push
+    std::size_t                 head_cache = 0;            // producer's copy of head
+
+public:
+
+    explicit SpscRing(std::size_t capacity)
+        : mask(ring_capacity(capacity) - 1), slots(new Slot[mask + 1]) {}
+    SpscRing(const SpscRing &) = delete;
+    SpscRing & operator=(const SpscRing &) = delete;
+    ~SpscRing()
+    {
+        while (front())
+            pop();
+    }
+
+    std::size_t capacity() const    { return mask + 1; }
+
+    // producer side
+    template<typename... Args>
+    bool try_emplace(Args &&... args)
+    {
+        const auto t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache > mask) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache > mask)
+                return false;
+        }
+        new (&slots[t & mask]) T(std::forward<Args>(args)...);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_push(T && t)           { return try_emplace(std::move(t)); }
+    bool try_push(const T & t)      { return try_emplace(t); }
+    // the element last pushed, after a push; its slot is reused by this side only
+    T * back()
+    {
+        return reinterpret_cast<T *>(&slots[(tail.load(std::memory_order_relaxed) - 1) & mask]);
+    }
+
+    // consumer side: nullptr if empty
+    T * front()
+    {
+        const auto h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache)
+                return nullptr;
+        }
+        return reinterpret_cast<T *>(&slots[h & mask]);
+    }
+    void pop()
+    {
+        const auto h = head.load(std::memory_order_relaxed);
+        reinterpret_cast<T *>(&slots[h & mask])->~T();
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // either side, a snapshot
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+    std::size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+// D. Vyukov's bounded queue with the consumer side simplified to a single consumer:
+// every cell carries a sequence number telling whether it is free for the producer
+// of lap n (seq == pos) or full for the consumer (seq == pos + 1).
+template<typename T>
+class MpscRing
+{
+    using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    struct Cell
+    {
+        std::atomic<std::size_t>    seq;
+        Slot                        value;
+    };
+
+    const std::size_t           mask;
+    std::unique_ptr<Cell[]>     cells;
+
+    alignas(CACHE_LINE) std::atomic<std::size_t> head{0};  // next to pop
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail{0};  // next to claim
+
+public:
+
+    explicit MpscRing(std::size_t capacity)
+        : mask(ring_capacity(capacity) - 1), cells(new Cell[mask + 1])
+    {
+        for (std::size_t i = 0; i <= mask; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    MpscRing(const MpscRing &) = delete;
+    MpscRing & operator=(const MpscRing &) = delete;
+    ~MpscRing()
+    {
+        while (front())
+            pop();
+    }
+
+    std::size_t capacity() const    { return mask + 1; }
+
+    // producer side, any thread
+    template<typename... Args>
+    bool try_emplace(Args &&... args)
+    {
+        auto pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell & cell = cells[pos & mask];
+            const auto seq = cell.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (&cell.value) T(std::forward<Args>(args)...);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;               // full
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+    bool try_push(T && t)           { return try_emplace(std::move(t)); }
+    bool try_push(const T & t)      { return try_emplace(t); }
+
+    // consumer side, one thread: nullptr if empty (or the next cell is still being written)
+    T * front()
+    {
+        const auto h = head.load(std::memory_order_relaxed);
+        Cell & cell = cells[h & mask];
+        if (cell.seq.load(std::memory_order_acquire) != h + 1)
+            return nullptr;
+        return reinterpret_cast<T *>(&cell.value);
+    }
+    void pop()
+    {
+        const auto h = head.load(std::memory_order_relaxed);
+        Cell & cell = cells[h & mask];
+        reinterpret_cast<T *>(&cell.value)->~T();
+        cell.seq.store(h + mask + 1, std::memory_order_release);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // either side, a snapshot
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+    std::size_t size() const
+    {
+        const auto h = head.load(std::memory_order_acquire);
+        const auto t = tail.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+};
+
+#endif
@@ -0,0 +1,158 @@
+// A bounded log of sent orders
+
+// [SentRecord] what the report needs of a sent order, 40 bytes of plain data.
+
+// [SentLog] keeps the latest records in a ring of fixed capacity. When the ring is
+//           full, its older half is spilled to a binary file of SentRecords in one
+//           or two write()s, so memory stays fixed however many orders are sent and
+//           the owner (the dispatcher) never reallocates. for_each() replays the
+//           file, then the ring, in the order the records were pushed. The file is
+//           completed with the ring when the log is destroyed.
+
+// [TraderStats] streaming aggregates of the orders of one trader, for the summary:
+//               count (also of those sent at the limits), first ids, and histograms
+//               of how long orders waited; those kept at several venues merge into
+//               one.
+
+#ifndef SENTLOG_HPP
+#define SENTLOG_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <string>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "hist.hpp"
+
+struct SentRecord
+{
+    std::uint64_t   id;
+    std::int64_t    creator;
+    std::int64_t    time_created;       // ns since begin
+    std::int64_t    time_to_send;
+    std::int64_t    time_sent;
+};
+
+class SentLog
+{
+    std::vector<SentRecord> ring;
+    std::size_t             head = 0;   // oldest record in the ring
+    std::size_t             count = 0;
+    std::string             path;
+    int                     fd = -1;
+    std::size_t             spilled = 0;
+    std::size_t             lost = 0;   // spilled but not written
+
+public:
+
+    SentLog(std::size_t capacity, const std::string & file)
+        : ring(std::max<std::size_t>(capacity, 2)), path(file) {}
+    SentLog(const SentLog &) = delete;
+    SentLog & operator=(const SentLog &) = delete;
+    ~SentLog()
+    {
+        if (fd < 0)
+            return;
+        spill(count);
+        ::close(fd);
+    }
+
+    void push(const SentRecord & r)
+    {
+        if (count == ring.size())
+            spill(count / 2);
+        ring[(head + count) % ring.size()] = r;
+        ++count;
+    }
+
+    std::size_t size() const            { return spilled + count; }
+    std::size_t get_spilled() const     { return spilled; }
+    std::size_t get_lost() const        { return lost;    }
+    const std::string & get_path() const { return path;   }
+
+    // f(const SentRecord &) on every record, oldest first
+    template<typename F>
+    void for_each(F f) const
+    {
+        if (spilled > lost) {
+            int in = ::open(path.c_str(), O_RDONLY);
+            SentRecord buffer[256];
+            ssize_t got;
+            while (in >= 0 && (got = ::read(in, buffer, sizeof buffer)) > 0)
+                for (ssize_t i = 0; i != got / static_cast<ssize_t>(sizeof(SentRecord)); ++i)
+                    f(buffer[i]);
+            if (in >= 0)
+                ::close(in);
+        }
+        for (std::size_t i = 0; i != count; ++i)
+            f(ring[(head + i) % ring.size()]);
+    }
+
+private:
+
+    // move the oldest n records from the ring to the file
+    void spill(std::size_t n)
+    {
+        if (n == 0)
+            return;
+        if (fd < 0 && lost == spilled)
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        const std::size_t first = std::min(n, ring.size() - head);
+        iovec iov[2] = {
+            { &ring[head], first * sizeof(SentRecord) },
+            { &ring[0], (n - first) * sizeof(SentRecord) }
+        };
+        std::size_t want = n * sizeof(SentRecord);
+        ssize_t put = fd < 0 ? -1 : ::writev(fd, iov, n > first ? 2 : 1);
+        if (put != static_cast<ssize_t>(want))
+            lost += n;
+        spilled += n;
+        head = (head + n) % ring.size();
+        count -= n;
+    }
+};
+
+struct TraderStats
+{
+    static constexpr std::size_t SHOWN = 11;    // ids kept to show in the summary
+
+    std::size_t     orders      = 0;
+    std::size_t     at_limits   = 0;            // sent while the limits held orders back
+    std::size_t     ids[SHOWN]  = {};
+    Time            wait_total  = Time::zero();
+    Histogram       wait;                       // from creation to sending
+    Histogram       throttle;                   // from creation to time to send
+
+    void add(const SentRecord & r)
+    {
+        if (orders < SHOWN)
+            ids[orders] = r.id;
+        ++orders;
+        wait_total += Time(r.time_sent - r.time_created);
+        wait.record(Time(r.time_sent - r.time_created));
+        throttle.record(Time(r.time_to_send - r.time_created));
+    }
+
+    // add the orders of the same trader kept elsewhere, e.g. at another venue
+    void merge(const TraderStats & t)
+    {
+        std::size_t merged[SHOWN];
+        std::size_t i = 0, j = 0, n = 0;
+        const std::size_t a = std::min(orders, SHOWN), b = std::min(t.orders, SHOWN);
+        while (n != SHOWN && (i != a || j != b))
+            merged[n++] = j == b || (i != a && ids[i] < t.ids[j]) ? ids[i++] : t.ids[j++];
+        std::copy(merged, merged + n, ids);
+        orders += t.orders;
+        at_limits += t.at_limits;
+        wait_total += t.wait_total;
+        wait.merge(t.wait);
+        throttle.merge(t.throttle);
+    }
+};
+
+#endif
@@ -0,0 +1,307 @@
+// Tests of the order system
+
+// Deterministic checks, each reporting one line; the run fails (exit status 1) if
+// any of them does not hold.
+
+// [limiter] Limiter::earliest() and allowance() against a brute-force count of the
+//           sends in each window, over random rules (one to three at once), random
+//           reserves and wants, and random send times, sending at each step as many
+//           orders as the limiter allows, some of them. The Audit must find no
+//           violation in the sends that result.
+
+// [limits] a million orders arriving at random, in bursts of about 20 a second
+//          between pauses of up to 4 hours, sent as early as the Limiter lets them
+//          under 10 a second, 500 a minute and 20000 a day, the last with a ring of
+//          20000 times: each rule must hold some back, and the Audit must find no
+//          violation.
+
+// [allocations] the order path, from creating an order to sending it, makes no heap
+//               allocation, in real time and simulated, with the features that
+//               touch it. This build replaces operator new to count the allocations
+//               of each thread (ORDER_COUNT_ALLOCATIONS); the program does not.
+
+// [simulation] a simulation logs more than one record in an event (a pass of a
+//              batch, or creating and revising an order) and drains the logger
+//              itself: it must finish, under a watchdog, losing no record even if
+//              dropping is allowed, also when a pass is larger than a lane.
+
+// [journal] a journal whose last run crashed, with orders created and not known to
+//           be sent: a restart must not send them again, and must mark them so
+//           that the next runs do not either; with --resend-unknown, it sends them.
+
+// To compile: g++ test.cpp -fopenmp -std=c++17 -O2 -o test
+
+// To run: test
+
+#define ORDER_NO_MAIN
+#define ORDER_COUNT_ALLOCATIONS
+#include "order.cpp"
+
+#include <csignal>
+#include <new>
+#include <sstream>
+
+thread_local size_t allocations = 0;
+
+// kept out of line, or GCC sees malloc / delete pairs through them and warns of a mismatch
+__attribute__((noinline)) void * operator new(size_t size)
+{
+    ++allocations;
+    if (void * p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void * p) noexcept           { std::free(p); }
+__attribute__((noinline)) void operator delete(void * p, size_t) noexcept   { std::free(p); }
+
+static int failures = 0;
+
+static void result(const string & name, bool ok, const string & detail)
+{
+    cout << (ok ? "ok  \t" : "FAIL\t") << name << "\t" << detail << endl;
+    failures += !ok;
+}
+
+// sends of one stream against its rules, by counting
+struct BruteForce
+{
+    vector<Rule>    rules;
+    vector<Time>    sends;
+
+    // sends in (t - len, t]
+    size_t in_window(const Rule & rule, Time t) const
+    {
+        return std::count_if(sends.begin(), sends.end(),
+                             [&](Time s) { return s > t - rule.len && s <= t; });
+    }
+    size_t allowance(Time t, size_t want, size_t reserve) const
+    {
+        for (const auto & rule : rules) {
+            const size_t limit = rule.max - std::min(reserve, rule.max - 1);
+            const size_t used = in_window(rule, t);
+            want = std::min(want, used < limit ? limit - used : 0);
+        }
+        return want;
+    }
+    // the first time at or after t when one may be sent: t, or a send leaving a window
+    Time earliest(Time t, size_t reserve) const
+    {
+        vector<Time> candidates{t};
+        for (const auto & rule : rules)
+            for (const auto s : sends)
+                if (s + rule.len > t)
+                    candidates.push_back(s + rule.len);
+        std::sort(candidates.begin(), candidates.end());
+        for (const auto c : candidates)
+            if (allowance(c, 1, reserve))
+                return c;
+        return INF;
+    }
+};
+
+static void test_limiter()
+{
+    std::mt19937_64 e(20180425);
+    auto uniform = [&e](long long lo, long long hi) {
+        return std::uniform_int_distribution<long long>(lo, hi)(e);
+    };
+    size_t queries = 0, sent = 0, mismatches = 0, violations = 0;
+    string first;
+    for (int round = 0; round != 500; ++round) {
+        BruteForce brute;
+        for (int i = uniform(1, 3); i; --i)
+            brute.rules.push_back(Rule{static_cast<size_t>(uniform(1, 8)), Time(uniform(1, 50))});
+        Limiter limiter(brute.rules);
+        Audit audit(brute.rules);
+        Time t = Time::zero();
+        for (int step = 0; step != 200; ++step) {
+            t += Time(uniform(0, 3) ? uniform(0, 20) : 0);
+            const size_t reserve = static_cast<size_t>(uniform(0, 1) ? 0 : uniform(1, 4));
+            const size_t want = static_cast<size_t>(uniform(1, 10));
+            const size_t allowed = limiter.allowance(t, want, reserve);
+            const Time earliest = limiter.earliest(t, reserve);
+            ++queries;
+            if (allowed != brute.allowance(t, want, reserve) || earliest != brute.earliest(t, reserve)) {
+                if (!mismatches++) {
+                    std::ostringstream oss;
+                    oss << ", first in round " << round << " at step " << step << ": allowance "
+                        << allowed << " for " << brute.allowance(t, want, reserve)
+                        << ", earliest " << earliest.count() << " for " << brute.earliest(t, reserve).count();
+                    first = oss.str();
+                }
+                break;
+            }
+            for (size_t n = static_cast<size_t>(uniform(0, static_cast<long long>(allowed))); n; --n) {
+                limiter.record(t);
+                audit.check(t);
+                brute.sends.push_back(t);
+                ++sent;
+            }
+        }
+        violations += audit.get_violations();
+    }
+    result("limiter", !mismatches && !violations,
+           std::to_string(queries) + " queries, " + std::to_string(sent) + " sends, "
+           + std::to_string(mismatches) + " mismatches, " + std::to_string(violations)
+           + " violations" + first);
+}
+
+static void test_limits()
+{
+    using std::chrono::seconds;
+    using std::chrono::hours;
+    const vector<Rule> rules{{10, seconds(1)}, {500, seconds(60)}, {20000, hours(24)}};
+    Limiter limiter(rules);
+    Audit audit(rules);
+    // each rule alone, to tell which ones held an order back
+    vector<Limiter> alone;
+    for (const auto & rule : rules)
+        alone.emplace_back(vector<Rule>{rule});
+    vector<size_t> held(rules.size());
+    std::mt19937_64 e(20180425);
+    std::exponential_distribution<double> gap(20.0);
+    std::uniform_int_distribution<long long> pause(0, 4 * 3600);
+    const size_t orders = 1000000;
+    Time arrival = Time::zero(), t = Time::zero();
+    for (size_t i = 0; i != orders; ++i) {
+        arrival += e() % 1000 ? Time(static_cast<long long>(gap(e) * 1e9)) : seconds(pause(e));
+        t = std::max(t, arrival);
+        const Time earliest = limiter.earliest(t);
+        for (size_t r = 0; r != rules.size(); ++r)
+            held[r] += alone[r].earliest(t) > t;
+        t = earliest;
+        limiter.record(t);
+        for (auto & l : alone)
+            l.record(t);
+        audit.check(t);
+    }
+    std::ostringstream oss;
+    oss << audit.get_checked() << " sends over "
+        << std::chrono::duration_cast<hours>(t).count() / 24 << " days, held back by each rule "
+        << held[0] << ", " << held[1] << ", " << held[2] << ", "
+        << audit.get_violations() << " violations";
+    result("limits", audit.get_checked() == orders && audit.get_violations() == 0
+                     && std::count(held.begin(), held.end(), 0) == 0, oss.str());
+}
+
+// run the system quietly with the options; the allocations on its order path
+static size_t run(const vector<string> & options)
+{
+    Spec spec;
+    spec.parse(options);
+    System sys(spec);
+    sys.start();
+    return sys.get_order_path_allocations();
+}
+
+static void test_allocations()
+{
+    const vector<string> base{"--quiet", "--orders=2000", "--cycle=0", "--max=100", "--len=10"};
+    const vector<vector<string>> variants{
+        {},
+        {"--batch=8", "--urgent=0.2", "--reserve=2", "--aging=5"},
+        {"--cancel=0.2", "--amend=0.2", "--fair", "--weights=2"},
+        {"--venue=50/10", "--venue=100/10,200/100", "--pace=4"},
+    };
+    size_t runs = 0, total = 0;
+    string found;
+    for (const bool sim : {false, true})
+        for (const auto & variant : variants) {
+            auto options = base;
+            options.insert(options.end(), variant.begin(), variant.end());
+            if (sim)
+                options.push_back("--sim");
+            const size_t n = run(options);
+            ++runs;
+            total += n;
+            if (n && found.empty())
+                for (const auto & o : options)
+                    found += " " + o;
+        }
+    result("allocations", total == 0, std::to_string(runs) + " runs, " + std::to_string(total)
+           + " allocations on the order path" + (found.empty() ? "" : ", first with" + found));
+}
+
+static void test_simulation()
+{
+    const vector<vector<string>> runs{
+        {"--orders=5000", "--traders=10", "--batch=8"},
+        {"--orders=5000", "--traders=10", "--batch=8", "--cancel=0.2", "--amend=0.2", "--log-overflow=drop"},
+        {"--orders=20000", "--batch=10000", "--max=1000", "--len=100", "--cycle=1", "--log-overflow=drop"},
+    };
+    // a simulation that blocks on a full lane never returns
+    std::signal(SIGALRM, [](int) {
+        static const char message[] = "FAIL\tsimulation\ttimed out\n";
+        (void) ::write(STDOUT_FILENO, message, sizeof message - 1);
+        std::_Exit(1);
+    });
+    size_t sent = 0, dropped = 0, short_runs = 0;
+    for (auto options : runs) {
+        const bool cancels = std::find(options.begin(), options.end(), "--cancel=0.2") != options.end();
+        const size_t orders = std::stoul(options[0].substr(options[0].find('=') + 1));
+        options.insert(options.end(), {"--sim", "--quiet"});
+        Spec spec;
+        spec.parse(options);
+        System sys(spec);
+        ::alarm(60);
+        sys.start();
+        ::alarm(0);
+        sent += sys.get_sent();
+        dropped += sys.get_dropped_log_records();
+        short_runs += !cancels && sys.get_sent() != orders;
+    }
+    result("simulation", dropped == 0 && short_runs == 0,
+           std::to_string(runs.size()) + " runs, " + std::to_string(sent) + " sent, "
+           + std::to_string(dropped) + " log records dropped, " + std::to_string(short_runs)
+           + " runs short of their orders");
+}
+
+// a journal of one run that crashed after creating orders 1 ~ n and sending the
+// first sent of them
+static void write_crashed_journal(const string & path, size_t n, size_t sent)
+{
+    vector<LogRecord> records{{LogRecord::BEGIN, 0, 0, 0, realtime_now() - 1000000000, 0}};
+    for (size_t id = 1; id <= n; ++id)
+        records.push_back(LogRecord{LogRecord::CREATED, 0, static_cast<std::int32_t>(id % 3 + 1), id, 0, 0});
+    for (size_t id = 1; id <= sent; ++id)
+        records.push_back(LogRecord{LogRecord::SENT, 0, static_cast<std::int32_t>(id % 3 + 1), id, 1000, 0});
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(LogRecord));
+}
+
+static void test_journal()
+{
+    const string path = "test-journal.bin";
+    const size_t n = 100, sent = 20;
+    const vector<string> base{"--quiet", "--orders=100", "--cycle=0", "--max=100", "--len=10",
+                              "--journal=" + path};
+    size_t resent[2] = {0, 0}, pending[2] = {0, 0};
+    for (const bool resend : {false, true}) {
+        write_crashed_journal(path, n, sent);
+        auto options = base;
+        if (resend)
+            options.push_back("--resend-unknown");
+        Spec spec;
+        spec.parse(options);
+        System sys(spec);
+        sys.start();
+        resent[resend] = sys.get_sent();
+        pending[resend] = replay(path).pending.size();
+    }
+    std::remove(path.c_str());
+    result("journal", resent[0] == 0 && pending[0] == 0 && resent[1] == n - sent && pending[1] == 0,
+           "after a crash with " + std::to_string(n - sent) + " orders unsent as far as known, sent "
+           + std::to_string(resent[0]) + " again and left " + std::to_string(pending[0])
+           + " pending, with --resend-unknown sent " + std::to_string(resent[1]) + " and left "
+           + std::to_string(pending[1]));
+}
+
+int main()
+{
+    test_limiter();
+    test_limits();
+    test_allocations();
+    test_simulation();
+    test_journal();
+    return failures ? 1 : 0;
+}
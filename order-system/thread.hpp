@@ -0,0 +1,123 @@
+// Dedicated threads for the roles of the order system
+
+// [Placement] where and how the threads of a role run: the CPUs they are pinned to
+//             (the i-th thread of the role to the i-th CPU listed, in turn; none
+//             for anywhere), a SCHED_FIFO priority (0 for the default policy) and a
+//             stack size (0 for the default).
+
+// [Thread] a pthread started with a placement and joined on destruction. A thread
+//          runs even if some of its placement could not be applied, e.g. a CPU the
+//          machine does not have or SCHED_FIFO without the privilege; what failed
+//          is kept as an error for the report.
+
+// Unlike an OpenMP team, there is one thread per role, as many as the spec asks,
+// and each may be placed on its own, e.g. a processing thread alone on an
+// isolated core at a real-time priority.
+
+#ifndef THREAD_HPP
+#define THREAD_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+struct Placement
+{
+    std::vector<int>    cpus;
+    int                 fifo    = 0;
+    std::size_t         stack   = 0;            // bytes
+
+    bool is_default() const     { return cpus.empty() && fifo == 0 && stack == 0; }
+};
+
+// e.g. "CPU 2, 3, SCHED_FIFO 50, stack 256 KB", or "anywhere"
+inline std::string to_string(const Placement & p)
+{
+    std::string s;
+    for (std::size_t i = 0; i != p.cpus.size(); ++i)
+        s += (i ? ", " : "CPU ") + std::to_string(p.cpus[i]);
+    if (p.fifo)
+        s += (s.empty() ? "" : ", ") + std::string("SCHED_FIFO ") + std::to_string(p.fifo);
+    if (p.stack)
+        s += (s.empty() ? "" : ", ") + std::string("stack ") + std::to_string(p.stack >> 10) + " KB";
+    return s.empty() ? "anywhere" : s;
+}
+
+class Thread
+{
+    pthread_t               handle;
+    bool                    started = false;
+    std::function<void()>   body;
+    std::string             error;
+
+    static void * run(void * self)
+    {
+        static_cast<Thread *>(self)->body();
+        return nullptr;
+    }
+
+    void fail(const std::string & what, int e)
+    {
+        error += (error.empty() ? "" : "; ") + what + ": " + std::strerror(e);
+    }
+
+public:
+
+    // start f as the i-th thread of a role placed so
+    Thread(std::function<void()> f, const Placement & p, std::size_t i) : body(std::move(f))
+    {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (p.stack) {
+            if (const int e = pthread_attr_setstacksize(&attr, p.stack))
+                fail("stack of " + std::to_string(p.stack >> 10) + " KB", e);
+        }
+        if (!p.cpus.empty()) {
+            const int cpu = p.cpus[i % p.cpus.size()];
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+            if (const int e = pthread_attr_setaffinity_np(&attr, sizeof set, &set))
+                fail("CPU " + std::to_string(cpu), e);
+        }
+        int e = pthread_create(&handle, &attr, run, this);
+        pthread_attr_destroy(&attr);
+        if (e) {
+            // e.g. a CPU the machine does not have: start as std::thread would
+            fail("placement", e);
+            e = pthread_create(&handle, nullptr, run, this);
+        }
+        started = e == 0;
+        if (!started) {
+            fail("start", e);
+            return;
+        }
+        if (p.fifo) {
+            sched_param param{};
+            param.sched_priority = p.fifo;
+            if (const int e = pthread_setschedparam(handle, SCHED_FIFO, &param))
+                fail("SCHED_FIFO " + std::to_string(p.fifo), e);
+        }
+    }
+    Thread(const Thread &) = delete;
+    Thread & operator=(const Thread &) = delete;
+    ~Thread()                               { join(); }
+
+    void join()
+    {
+        if (started)
+            pthread_join(handle, nullptr);
+        started = false;
+    }
+
+    // what of the placement could not be applied, empty if all was
+    const std::string & get_error() const   { return error; }
+};
+
+#endif
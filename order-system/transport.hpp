@@ -0,0 +1,134 @@
+// Transports of the orders the processing threads send
+
+// [Transport] what a venue's processing thread hands each pass of sent orders to,
+//             as a batch of WireOrders (wire.hpp), and what became of them: how
+//             many were answered, rejected, and their round trips. Without one,
+//             sending an order is recording it, as it always was.
+
+// [SocketTransport] sends every batch to an exchange over a Unix-domain socket in
+//                   one sendmsg() (a writev() that raises no SIGPIPE), straight
+//                   from the buffer of the venue the messages were built in. A
+//                   receiver thread reads the acks as they come, measuring the
+//                   round trip of each order and counting rejections, until the
+//                   exchange closes the connection after acking the last order.
+//                   See exchange.cpp for a mock exchange.
+
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "clock.hpp"
+#include "hist.hpp"
+#include "wire.hpp"
+
+class Transport
+{
+protected:
+
+    std::size_t     sent = 0;
+    std::size_t     acked = 0;
+    std::size_t     rejected = 0;
+    Histogram       round_trip;             // from sending to reading the ack
+
+public:
+
+    virtual ~Transport() = default;
+
+    // hand over n orders sent at once; false if they could not be
+    virtual bool send(const WireOrder * orders, std::size_t n) = 0;
+    // no more orders: wait until all are answered, if they are
+    virtual void finish() = 0;
+
+    // after finish()
+    std::size_t get_sent() const            { return sent;       }
+    std::size_t get_acked() const           { return acked;      }
+    std::size_t get_rejected() const        { return rejected;   }
+    const Histogram & get_round_trip() const { return round_trip; }
+};
+
+class SocketTransport : public Transport
+{
+    int             fd = -1;
+    std::thread     receiver;
+    std::string     error;                  // why the connection failed, if it did
+
+    void receive()
+    {
+        WireAck acks[256];
+        std::size_t have = 0;               // bytes
+        for (;;) {
+            const ssize_t got = ::read(fd, reinterpret_cast<char *>(acks) + have, sizeof acks - have);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                break;
+            const Time now = monotonic_now();
+            have += static_cast<std::size_t>(got);
+            const std::size_t n = have / sizeof(WireAck);
+            for (std::size_t i = 0; i != n; ++i) {
+                round_trip.record(now - Time(acks[i].sent));
+                rejected += acks[i].status == WireAck::REJECTED;
+            }
+            acked += n;
+            have -= n * sizeof(WireAck);
+            std::memmove(acks, acks + n, have);
+        }
+    }
+
+public:
+
+    explicit SocketTransport(const std::string & path)
+    {
+        sockaddr_un address;
+        if (!unix_address(path, address)) {
+            error = "bad socket path";
+            return;
+        }
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof address) < 0) {
+            error = std::strerror(errno);
+            if (fd >= 0)
+                ::close(fd);
+            fd = -1;
+            return;
+        }
+        receiver = std::thread([this] { receive(); });
+    }
+    SocketTransport(const SocketTransport &) = delete;
+    SocketTransport & operator=(const SocketTransport &) = delete;
+    ~SocketTransport() override
+    {
+        finish();
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    bool send(const WireOrder * orders, std::size_t n) override
+    {
+        iovec iov{const_cast<WireOrder *>(orders), n * sizeof(WireOrder)};
+        if (fd < 0 || !send_all(fd, &iov, 1))
+            return false;
+        sent += n;
+        return true;
+    }
+
+    void finish() override
+    {
+        if (!receiver.joinable())
+            return;
+        ::shutdown(fd, SHUT_WR);
+        receiver.join();
+    }
+
+    bool is_connected() const               { return fd >= 0; }
+    const std::string & get_error() const   { return error; }
+};
+
+#endif
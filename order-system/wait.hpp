@@ -0,0 +1,200 @@
+// Wait strategies for the threads of the order system that wait for work
+
+// [SPIN]    poll in a loop with a pause hint: lowest wake-up latency, burns a core.
+
+// [YIELD]   poll in a loop, giving up the core between polls.
+
+// [FUTEX]   adaptive: spin a little, yield a little, then sleep in the kernel on a
+//           futex until notified or a deadline passes.
+
+// [CONDVAR] adaptive like FUTEX, but sleeps on a mutex and condition variable.
+
+// A consumer waits on a Signal: it reads the epoch with prepare(), checks its
+// queues, and if there is nothing to do waits for the epoch to move. A producer
+// calls notify() after each push; the system call to wake a sleeper is only made
+// when somebody actually sleeps.
+
+#ifndef WAIT_HPP
+#define WAIT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <mutex>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+#include "clock.hpp"
+#include "hist.hpp"
+#include "queue.hpp"
+
+enum class Wait { SPIN, YIELD, FUTEX, CONDVAR };
+
+inline const char * to_string(Wait w)
+{
+    switch (w) {
+        case Wait::SPIN:    return "spin";
+        case Wait::YIELD:   return "yield";
+        case Wait::FUTEX:   return "futex";
+        case Wait::CONDVAR: return "condvar";
+    }
+    return "?";
+}
+
+inline bool parse_wait(const std::string & s, Wait & w)
+{
+    for (auto c : {Wait::SPIN, Wait::YIELD, Wait::FUTEX, Wait::CONDVAR})
+        if (s == to_string(c)) {
+            w = c;
+            return true;
+        }
+    return false;
+}
+
+// CPU time consumed by the calling thread
+inline Time thread_cpu_time()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return seconds(ts.tv_sec) + Time(ts.tv_nsec);
+}
+
+// what a thread's waits cost, kept by that thread only
+struct WaitStats
+{
+    Wait        strategy    = Wait::SPIN;
+    size_t      waits       = 0;            // times there was nothing to do
+    size_t      parks       = 0;            // times it slept in the kernel
+    size_t      wakes       = 0;            // wake-ups with a measured latency
+    Time        wake_total  = Time::zero(); // from notify or deadline to running again
+    Time        wake_max    = Time::zero();
+    Histogram   wake;                       // of the latencies, for their jitter
+    Time        cpu         = Time::zero(); // CPU time of the thread's role
+    Time        wall        = Time::zero(); // wall time of the thread's role
+
+    void record_wake(Time latency)
+    {
+        latency = std::max(latency, Time::zero());
+        ++wakes;
+        wake_total += latency;
+        wake_max = std::max(wake_max, latency);
+        wake.record(latency);
+    }
+};
+
+class Signal
+{
+    static constexpr int SPINS  = 256;
+    static constexpr int YIELDS = 16;
+
+    alignas(CACHE_LINE) std::atomic<std::uint32_t> epoch{0};
+    std::atomic<int>            sleepers{0};
+    std::atomic<std::int64_t>   notified_at{0};     // monotonic ns of the last notify
+    std::mutex                  mutex;
+    std::condition_variable     cv;
+
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(int), "futex word");
+
+public:
+
+    std::uint32_t prepare() const   { return epoch.load(std::memory_order_seq_cst); }
+
+    void notify()
+    {
+        // stamped before the epoch moves, so a waiter that sees the move sees the stamp
+        notified_at.store(monotonic_now().count(), std::memory_order_relaxed);
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        cv.notify_all();
+        syscall(SYS_futex, reinterpret_cast<int *>(&epoch), FUTEX_WAKE_PRIVATE, INT32_MAX,
+                nullptr, nullptr, 0);
+    }
+
+    // wait until the epoch moves past seen, or until the deadline (CLOCK_MONOTONIC)
+    void wait(std::uint32_t seen, Time deadline, WaitStats & stats)
+    {
+        ++stats.waits;
+        auto moved = [&] { return epoch.load(std::memory_order_seq_cst) != seen; };
+        auto due = [&] { return deadline != INF && monotonic_now() >= deadline; };
+        auto woken = [&] {
+            stats.record_wake(monotonic_now() - Time(notified_at.load(std::memory_order_relaxed)));
+        };
+        const Wait w = stats.strategy;
+
+        if (moved())
+            return;
+        for (int i = 0; w != Wait::YIELD && (w == Wait::SPIN || i < SPINS); ++i) {
+            if (moved())
+                return woken();
+            if (due())
+                return;
+            cpu_relax();
+        }
+        for (int i = 0; w == Wait::YIELD || i < YIELDS; ++i) {
+            if (moved())
+                return woken();
+            if (due())
+                return;
+            std::this_thread::yield();
+        }
+
+        // park
+        ++stats.parks;
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (w == Wait::FUTEX) {
+            while (!moved() && !due()) {
+                timespec ts, * timeout = nullptr;
+                if (deadline != INF) {
+                    const auto left = deadline - monotonic_now();
+                    ts.tv_sec = static_cast<time_t>(left.count() / 1000000000);
+                    ts.tv_nsec = static_cast<long>(left.count() % 1000000000);
+                    timeout = &ts;
+                }
+                syscall(SYS_futex, reinterpret_cast<int *>(&epoch), FUTEX_WAIT_PRIVATE,
+                        static_cast<int>(seen), timeout, nullptr, 0);
+            }
+        }
+        else {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!moved() && !due()) {
+                if (deadline == INF)
+                    cv.wait(lock);
+                else
+                    cv.wait_for(lock, deadline - monotonic_now());
+            }
+        }
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        if (moved())
+            woken();
+    }
+};
+
+// wait until clock reads t, in the manner of the strategy; record how late we woke
+inline void wait_until(const Clock & clock, Time t, WaitStats & stats)
+{
+    ++stats.waits;
+    switch (stats.strategy) {
+        case Wait::SPIN:
+            clock.spin_until(t);
+            break;
+        case Wait::YIELD:
+            while (clock.now() < t)
+                std::this_thread::yield();
+            break;
+        default:
+            ++stats.parks;
+            clock.sleep_until(t);
+    }
+    stats.record_wake(clock.now() - t);
+}
+
+#endif
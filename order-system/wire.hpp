@@ -0,0 +1,92 @@
+// Binary wire protocol between the order system and an exchange
+
+// [WireOrder] an order as sent, 32 bytes of fixed layout in host byte order (the
+//             exchange is local): the id, trader, venue, quantity and price, and
+//             the sender's monotonic time of sending, which the exchange echoes.
+
+// [WireAck] the exchange's answer to each order, 24 bytes: ACCEPTED, or REJECTED if
+//           the order broke a limit of the exchange's own windows, with the echoed
+//           time so the sender measures the round trip without keeping state.
+
+// A connection is a stream of orders one way and of acks the other way, one ack
+// per order and in the same order, with no framing beyond the fixed sizes.
+
+#ifndef WIRE_HPP
+#define WIRE_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <string>
+#include <unistd.h>
+
+struct WireOrder
+{
+    enum Type : std::uint16_t { ORDER = 0x4f52 };      // "OR"
+
+    std::uint16_t   type;
+    std::uint16_t   venue;          // from 1
+    std::int32_t    trader;
+    std::uint64_t   id;
+    std::int32_t    quantity;
+    std::int32_t    price;          // in ticks
+    std::int64_t    sent;           // monotonic ns at the sender
+};
+
+struct WireAck
+{
+    enum Status : std::uint16_t { ACCEPTED, REJECTED };
+
+    std::uint16_t   type;           // WireOrder::ORDER, of the message acked
+    std::uint16_t   status;
+    std::uint32_t   padding;        // 0
+    std::uint64_t   id;
+    std::int64_t    sent;           // echoed
+};
+
+static_assert(sizeof(WireOrder) == 32, "WireOrder is sent as it is");
+static_assert(sizeof(WireAck) == 24, "WireAck is sent as it is");
+
+// send all of the buffers on a socket in as few calls as it takes, retrying on
+// interruption and after short sends, without SIGPIPE if the peer is gone; false
+// on error
+inline bool send_all(int fd, iovec * iov, int n)
+{
+    while (n) {
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = static_cast<std::size_t>(n);
+        const ssize_t put = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR)
+            continue;
+        if (put <= 0)
+            return false;
+        std::size_t left = static_cast<std::size_t>(put);
+        while (n && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --n;
+        }
+        if (n) {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+// the address of a Unix-domain socket at path; false if the path is too long
+inline bool unix_address(const std::string & path, sockaddr_un & address)
+{
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof address.sun_path)
+        return false;
+    path.copy(address.sun_path, path.size());
+    return true;
+}
+
+#endif